@@ -0,0 +1,129 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+
+#include "RMSAnimationAssetUserData.h"
+
+#include "AnimNotifyState_RMS.h"
+#include "RMSAnimationCache.h"
+#include "RMSLibrary.h"
+#include "Animation/AnimSequenceBase.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/ObjectSaveContext.h"
+
+URMSAnimationAssetUserData* URMSAnimationAssetUserData::Get(const UAnimSequenceBase* Animation)
+{
+	if (!Animation)
+	{
+		return nullptr;
+	}
+	return Cast<URMSAnimationAssetUserData>(
+		const_cast<UAnimSequenceBase*>(Animation)->GetAssetUserDataOfClass(StaticClass()));
+}
+
+#if WITH_EDITOR
+URMSAnimationAssetUserData* URMSAnimationAssetUserData::BakeToAsset(UAnimSequenceBase* Animation, float SampleRate)
+{
+	if (!Animation)
+	{
+		return nullptr;
+	}
+	URMSAnimationAssetUserData* UserData = Get(Animation);
+	if (!UserData)
+	{
+		Animation->Modify();
+		UserData = NewObject<URMSAnimationAssetUserData>(Animation, NAME_None, RF_Transactional);
+		Animation->AddAssetUserData(UserData);
+	}
+	UserData->Modify();
+	if (SampleRate > 0.f)
+	{
+		UserData->BakeSampleRate = SampleRate;
+	}
+	UserData->Rebuild(Animation);
+	Animation->MarkPackageDirty();
+	return UserData;
+}
+
+void URMSAnimationAssetUserData::Rebuild(UAnimSequenceBase* Animation)
+{
+	RootMotionPrefix.Reset();
+	Windows.Reset();
+	PlayLength = 0.f;
+	SampleRate = 0.f;
+	if (!Animation)
+	{
+		return;
+	}
+
+	for (const FAnimNotifyEvent& Noti : Animation->Notifies)
+	{
+		if (UAnimNotifyState_RMS_Warping* RMSNoti = Cast<UAnimNotifyState_RMS_Warping>(Noti.NotifyStateClass))
+		{
+			FRMSWindowData& Window = Windows.AddDefaulted_GetRef();
+			Window.AnimNotify = RMSNoti;
+			Window.StartTime = Noti.GetTriggerTime();
+			Window.EndTime = Noti.GetEndTriggerTime();
+		}
+	}
+
+	const FRMSBakedRootMotionPtr Baked = FRMSBakedRootMotion::Bake(Animation, FMath::Max(BakeSampleRate, 1.f), false);
+	if (Baked.IsValid())
+	{
+		SampleRate = Baked->SampleRate;
+		PlayLength = Baked->PlayLength;
+		RootMotionPrefix = Baked->Prefix;
+	}
+	//已经缓存的数据可能是旧的
+	FRMSAnimationCache::Get().Invalidate(Animation);
+}
+
+void URMSAnimationAssetUserData::PreSave(FObjectPreSaveContext SaveContext)
+{
+	Super::PreSave(SaveContext);
+	if (!HasAnyFlags(RF_ClassDefaultObject | RF_ArchetypeObject))
+	{
+		Rebuild(Cast<UAnimSequenceBase>(GetOuter()));
+	}
+}
+
+void URMSAnimationAssetUserData::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(URMSAnimationAssetUserData, BakeSampleRate))
+	{
+		Rebuild(Cast<UAnimSequenceBase>(GetOuter()));
+	}
+}
+
+namespace
+{
+void BakeAnimationData(const TArray<FString>& Args)
+{
+	if (Args.Num() < 2)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Usage: RMS.BakeAnimationData SampleRate AnimationPath [AnimationPath...]"));
+		return;
+	}
+	const float SampleRate = FCString::Atof(*Args[0]);
+	TArray<UAnimSequenceBase*> Animations;
+	for (int32 i = 1; i < Args.Num(); i++)
+	{
+		if (UAnimSequenceBase* Animation = LoadObject<UAnimSequenceBase>(nullptr, *Args[i]))
+		{
+			Animations.Add(Animation);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("RMS.BakeAnimationData: can not load animation %s"), *Args[i]);
+		}
+	}
+	const int32 Num = URMSLibrary::BakeAnimationRootMotionData(Animations, SampleRate);
+	UE_LOG(LogTemp, Log, TEXT("RMS.BakeAnimationData: baked %d animations, save them to keep the data"), Num);
+}
+
+FAutoConsoleCommand BakeAnimationDataCommand(TEXT("RMS.BakeAnimationData"),
+                                             TEXT("RMS.BakeAnimationData SampleRate AnimationPath [AnimationPath...]: add or rebuild URMSAnimationAssetUserData on animations"),
+                                             FConsoleCommandWithArgsDelegate::CreateStatic(&BakeAnimationData));
+}
+#endif
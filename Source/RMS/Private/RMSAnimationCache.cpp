@@ -0,0 +1,321 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+
+#include "RMSAnimationCache.h"
+
+#include "AnimNotifyState_RMS.h"
+#include "RMSAnimationAssetUserData.h"
+#include "RMSLibrary.h"
+#include "RMSRootMotionLibrary.h"
+#include "RMSTypes.h"
+#include "Animation/AnimSequenceBase.h"
+#include "Misc/ScopeRWLock.h"
+#include "UObject/UObjectGlobals.h"
+
+
+FTransform FRMSBakedRootMotion::ExtractRootMotion(float StartTime, float EndTime) const
+{
+	if (!IsValid())
+	{
+		return FTransform::Identity;
+	}
+	int32 StartIndex, EndIndex;
+	float StartAlpha, EndAlpha;
+	GetSamplePosition(StartTime, StartIndex, StartAlpha);
+	GetSamplePosition(EndTime, EndIndex, EndAlpha);
+	//先插值前缀再求逆, 分别插值Prefix和PrefixInverse在采样点之间不互逆, ExtractRootMotion(t, t)就不是Identity
+	const FTransform StartInverse = StartAlpha > 0.f
+		                                ? BlendSamples(Prefix, StartIndex, StartAlpha).Inverse()
+		                                : PrefixInverse[StartIndex];
+	//EndTime < StartTime 时自然得到反向的RootMotion
+	return BlendSamples(Prefix, EndIndex, EndAlpha) * StartInverse;
+}
+
+FTransform FRMSBakedRootMotion::GetRootMotionAtTime(float Time) const
+{
+	if (!IsValid())
+	{
+		return FTransform::Identity;
+	}
+	int32 Index;
+	float Alpha;
+	GetSamplePosition(Time, Index, Alpha);
+	return BlendSamples(Prefix, Index, Alpha);
+}
+
+FRMSBakedRootMotionPtr FRMSBakedRootMotion::Bake(UAnimSequenceBase* Animation, float SampleRate, bool bUseAssetData)
+{
+	if (!Animation)
+	{
+		return nullptr;
+	}
+	if (bUseAssetData)
+	{
+		const URMSAnimationAssetUserData* UserData = URMSAnimationAssetUserData::Get(Animation);
+		if (UserData && UserData->HasRootMotion())
+		{
+			TSharedPtr<FRMSBakedRootMotion, ESPMode::ThreadSafe> Baked = MakeShared<
+				FRMSBakedRootMotion, ESPMode::ThreadSafe>();
+			const int32 NumSamples = UserData->RootMotionPrefix.Num() - 1;
+			Baked->bFromAssetData = true;
+			Baked->PlayLength = UserData->PlayLength;
+			Baked->SampleRate = UserData->SampleRate;
+			Baked->SampleInterval = UserData->PlayLength / NumSamples;
+			Baked->Prefix = UserData->RootMotionPrefix;
+			Baked->PrefixInverse.SetNumUninitialized(NumSamples + 1);
+			for (int32 i = 0; i <= NumSamples; i++)
+			{
+				Baked->PrefixInverse[i] = Baked->Prefix[i].Inverse();
+			}
+			return Baked;
+		}
+	}
+	if (SampleRate <= 0.f || Animation->GetPlayLength() <= 0.f)
+	{
+		return nullptr;
+	}
+	TSharedPtr<FRMSBakedRootMotion, ESPMode::ThreadSafe> Baked = MakeShared<FRMSBakedRootMotion, ESPMode::ThreadSafe>();
+	Baked->PlayLength = Animation->GetPlayLength();
+	//均分整个动画, 实际采样率会略高于设定值
+	const int32 NumSamples = FMath::Max(1, FMath::CeilToInt(Baked->PlayLength * SampleRate));
+	Baked->SampleRate = SampleRate;
+	Baked->SampleInterval = Baked->PlayLength / NumSamples;
+	Baked->Prefix.SetNumUninitialized(NumSamples + 1);
+	Baked->PrefixInverse.SetNumUninitialized(NumSamples + 1);
+	Baked->Prefix[0] = FTransform::Identity;
+	Baked->PrefixInverse[0] = FTransform::Identity;
+	//逐段累加, 与CMC里累加RootMotion的顺序一致(新 * 旧)
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		const float SampleStart = i * Baked->SampleInterval;
+		const float SampleEnd = i == NumSamples - 1 ? Baked->PlayLength : (i + 1) * Baked->SampleInterval;
+		FTransform Accumulated = URMSLibrary::ExtractRootMotion(Animation, SampleStart, SampleEnd) * Baked->Prefix[i];
+		Accumulated.NormalizeRotation();
+		Baked->Prefix[i + 1] = Accumulated;
+		Baked->PrefixInverse[i + 1] = Accumulated.Inverse();
+	}
+	return Baked;
+}
+
+FRMSWindowIndexPtr FRMSWindowIndex::Build(const UAnimSequenceBase* Animation)
+{
+	if (!Animation)
+	{
+		return nullptr;
+	}
+	TSharedPtr<FRMSWindowIndex, ESPMode::ThreadSafe> Index = MakeShared<FRMSWindowIndex, ESPMode::ThreadSafe>();
+	if (const URMSAnimationAssetUserData* UserData = URMSAnimationAssetUserData::Get(Animation))
+	{
+		Index->Windows = UserData->Windows;
+	}
+	else
+	{
+		for (const FAnimNotifyEvent& Noti : Animation->Notifies)
+		{
+			if (UAnimNotifyState_RMS_Warping* RMSNoti = Cast<UAnimNotifyState_RMS_Warping>(Noti.NotifyStateClass))
+			{
+				FRMSWindowData& Window = Index->Windows.AddDefaulted_GetRef();
+				Window.AnimNotify = RMSNoti;
+				Window.StartTime = Noti.GetTriggerTime();
+				Window.EndTime = Noti.GetEndTriggerTime();
+			}
+		}
+	}
+	Index->IndexByName.Reserve(Index->Windows.Num());
+	for (int32 i = 0; i < Index->Windows.Num(); i++)
+	{
+		if (Index->Windows[i].IsValid())
+		{
+			const FName Name = Index->Windows[i].AnimNotify->RootMotionSourceTarget;
+			if (!Index->IndexByName.Contains(Name))
+			{
+				Index->IndexByName.Add(Name, i);
+			}
+		}
+	}
+	return Index;
+}
+
+FRMSAnimationCache& FRMSAnimationCache::Get()
+{
+	static FRMSAnimationCache Instance;
+	return Instance;
+}
+
+void FRMSAnimationCache::Startup()
+{
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(
+		this, &FRMSAnimationCache::OnPostGarbageCollect);
+#if WITH_EDITOR
+	PropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddRaw(
+		this, &FRMSAnimationCache::OnObjectPropertyChanged);
+#endif
+}
+
+void FRMSAnimationCache::Shutdown()
+{
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+#if WITH_EDITOR
+	FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(PropertyChangedHandle);
+#endif
+	Empty();
+}
+
+FRMSBakedRootMotionPtr FRMSAnimationCache::FindOrBakeRootMotion(UAnimSequenceBase* Animation)
+{
+	const float SampleRate = RMS::CVarRMS_RootMotionBakeRate.GetValueOnAnyThread();
+	if (!Animation)
+	{
+		return nullptr;
+	}
+	const FObjectKey Key(Animation);
+	{
+		FReadScopeLock ReadLock(Lock);
+		if (const FRMSBakedRootMotionPtr* Found = BakedRootMotions.Find(Key))
+		{
+			if (*Found && ((*Found)->bFromAssetData || (*Found)->SampleRate == SampleRate))
+			{
+				return *Found;
+			}
+		}
+	}
+
+	FRMSBakedRootMotionPtr Baked;
+	{
+		FReadScopeLock ReadLock(Lock);
+		const FName ClipName = Libraries.Num() > 0 ? FName(*Animation->GetPathName()) : NAME_None;
+		for (const FRMSRootMotionLibraryPtr& Library : Libraries)
+		{
+			const int32 ClipIndex = Library->FindClip(ClipName);
+			if (ClipIndex != INDEX_NONE)
+			{
+				Baked = Library->MakeBakedRootMotion(ClipIndex);
+				break;
+			}
+		}
+	}
+	//烘焙在锁外进行, 同一个动画被同时烘焙也只是多做一次, 结果相同
+	if (!Baked.IsValid())
+	{
+		Baked = FRMSBakedRootMotion::Bake(Animation, SampleRate);
+	}
+	if (Baked)
+	{
+		FWriteScopeLock WriteLock(Lock);
+		BakedRootMotions.Add(Key, Baked);
+	}
+	return Baked;
+}
+
+FRMSWindowIndexPtr FRMSAnimationCache::FindOrBuildWindowIndex(const UAnimSequenceBase* Animation)
+{
+	if (!Animation)
+	{
+		return nullptr;
+	}
+	const FObjectKey Key(Animation);
+	{
+		FReadScopeLock ReadLock(Lock);
+		if (const FRMSWindowIndexPtr* Found = WindowIndices.Find(Key))
+		{
+			return *Found;
+		}
+	}
+	FRMSWindowIndexPtr Index = FRMSWindowIndex::Build(Animation);
+	if (Index)
+	{
+		FWriteScopeLock WriteLock(Lock);
+		WindowIndices.Add(Key, Index);
+	}
+	return Index;
+}
+
+FTransform FRMSAnimationCache::ExtractRootMotion(UAnimSequenceBase* Animation, const FRMSBakedRootMotion* Baked,
+                                                 float StartTime, float EndTime)
+{
+	if (Baked && Baked->IsValid())
+	{
+		return Baked->ExtractRootMotion(StartTime, EndTime);
+	}
+	return URMSLibrary::ExtractRootMotion(Animation, StartTime, EndTime);
+}
+
+void FRMSAnimationCache::Invalidate(const UObject* Animation)
+{
+	FWriteScopeLock WriteLock(Lock);
+	BakedRootMotions.Remove(FObjectKey(Animation));
+	WindowIndices.Remove(FObjectKey(Animation));
+}
+
+void FRMSAnimationCache::Empty()
+{
+	FWriteScopeLock WriteLock(Lock);
+	BakedRootMotions.Empty();
+	WindowIndices.Empty();
+	Libraries.Empty();
+}
+
+void FRMSAnimationCache::AddLibrary(const FRMSRootMotionLibraryPtr& Library)
+{
+	if (Library.IsValid())
+	{
+		FWriteScopeLock WriteLock(Lock);
+		Libraries.AddUnique(Library);
+		//已经烘焙过的数据以库为准
+		BakedRootMotions.Empty();
+	}
+}
+
+void FRMSAnimationCache::RemoveLibrary(const FRMSRootMotionLibraryPtr& Library)
+{
+	FWriteScopeLock WriteLock(Lock);
+	if (Libraries.Remove(Library) > 0)
+	{
+		BakedRootMotions.Empty();
+	}
+}
+
+void FRMSAnimationCache::OnPostGarbageCollect()
+{
+	FWriteScopeLock WriteLock(Lock);
+	for (auto It = BakedRootMotions.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().ResolveObjectPtr())
+		{
+			It.RemoveCurrent();
+		}
+	}
+	for (auto It = WindowIndices.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().ResolveObjectPtr())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+#if WITH_EDITOR
+void FRMSAnimationCache::OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& Event)
+{
+	UAnimSequenceBase* Animation = Cast<UAnimSequenceBase>(Object);
+	//窗口索引缓存了Notify上的RootMotionSourceTarget, 修改Notify时要让它所在的动画失效
+	if (!Animation && Object && Object->IsA<UAnimNotifyState_RMS_Warping>())
+	{
+		Animation = Object->GetTypedOuter<UAnimSequenceBase>();
+	}
+	if (Animation)
+	{
+		//预计算数据跟着一起更新, Rebuild内部会清除缓存
+		if (URMSAnimationAssetUserData* UserData = URMSAnimationAssetUserData::Get(Animation))
+		{
+			UserData->Modify();
+			UserData->Rebuild(Animation);
+		}
+		else
+		{
+			Invalidate(Animation);
+		}
+	}
+}
+#endif
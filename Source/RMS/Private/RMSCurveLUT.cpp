@@ -0,0 +1,142 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+
+#include "RMSCurveLUT.h"
+
+#include "RMSLibrary.h"
+#include "RMSTypes.h"
+#include "Curves/CurveFloat.h"
+#include "Curves/CurveVector.h"
+
+namespace
+{
+bool IsConstantExtrapolation(const FRichCurve& Curve)
+{
+	return Curve.GetNumKeys() == 0 || (Curve.PreInfinityExtrap == RCCE_Constant && Curve.PostInfinityExtrap ==
+		RCCE_Constant);
+}
+
+int32 GetLUTResolution()
+{
+	const int32 Resolution = RMS::CVarRMS_CurveLUTResolution.GetValueOnAnyThread();
+	return Resolution > 0 ? FMath::Max(Resolution, 2) : 0;
+}
+
+//误差相对于曲线的值域, 值域太小时按绝对误差处理
+bool IsWithinTolerance(float MaxError, float MinValue, float MaxValue)
+{
+	return MaxError <= RMS::CVarRMS_CurveLUTTolerance.GetValueOnAnyThread() * FMath::Max(MaxValue - MinValue, 1.f);
+}
+}
+
+FRMSCurveLUTPtr FRMSCurveLUT::Build(const UCurveFloat* Curve)
+{
+	const int32 Resolution = GetLUTResolution();
+	if (!Curve || Resolution <= 0 || !IsConstantExtrapolation(Curve->FloatCurve))
+	{
+		return nullptr;
+	}
+	TSharedPtr<FRMSCurveLUT, ESPMode::ThreadSafe> LUT = MakeShared<FRMSCurveLUT, ESPMode::ThreadSafe>();
+	Curve->GetTimeRange(LUT->MinTime, LUT->MaxTime);
+	const float Step = (LUT->MaxTime - LUT->MinTime) / (Resolution - 1);
+	float MinValue = TNumericLimits<float>::Max();
+	float MaxValue = TNumericLimits<float>::Lowest();
+	LUT->Values.SetNumUninitialized(Resolution);
+	for (int32 i = 0; i < Resolution; i++)
+	{
+		const float Value = Curve->GetFloatValue(LUT->MinTime + Step * i);
+		LUT->Values[i] = Value;
+		MinValue = FMath::Min(MinValue, Value);
+		MaxValue = FMath::Max(MaxValue, Value);
+	}
+	for (int32 i = 0; i < Resolution - 1; i++)
+	{
+		const float Mid = Curve->GetFloatValue(LUT->MinTime + Step * (i + 0.5f));
+		LUT->MaxError = FMath::Max(LUT->MaxError, FMath::Abs(Mid - (LUT->Values[i] + LUT->Values[i + 1]) * 0.5f));
+	}
+	if (!IsWithinTolerance(LUT->MaxError, MinValue, MaxValue))
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("RMS curve LUT for %s discarded, max error %f"), *Curve->GetName(),
+		       LUT->MaxError);
+		return nullptr;
+	}
+	return LUT;
+}
+
+FRMSVectorCurveLUTPtr FRMSVectorCurveLUT::Build(const UCurveVector* Curve)
+{
+	const int32 Resolution = GetLUTResolution();
+	if (!Curve || Resolution <= 0)
+	{
+		return nullptr;
+	}
+	for (const FRichCurve& FloatCurve : Curve->FloatCurves)
+	{
+		if (!IsConstantExtrapolation(FloatCurve))
+		{
+			return nullptr;
+		}
+	}
+	TSharedPtr<FRMSVectorCurveLUT, ESPMode::ThreadSafe> LUT = MakeShared<FRMSVectorCurveLUT, ESPMode::ThreadSafe>();
+	Curve->GetTimeRange(LUT->MinTime, LUT->MaxTime);
+	const float Step = (LUT->MaxTime - LUT->MinTime) / (Resolution - 1);
+	FVector MinValue(TNumericLimits<double>::Max());
+	FVector MaxValue(TNumericLimits<double>::Lowest());
+	LUT->Values.SetNumUninitialized(Resolution);
+	for (int32 i = 0; i < Resolution; i++)
+	{
+		const FVector Value = Curve->GetVectorValue(LUT->MinTime + Step * i);
+		LUT->Values[i] = FVector4f(Value.X, Value.Y, Value.Z, 0.f);
+		MinValue = MinValue.ComponentMin(Value);
+		MaxValue = MaxValue.ComponentMax(Value);
+	}
+	for (int32 i = 0; i < Resolution - 1; i++)
+	{
+		const FVector Mid = Curve->GetVectorValue(LUT->MinTime + Step * (i + 0.5f));
+		const FVector4f Lerped = (LUT->Values[i] + LUT->Values[i + 1]) * 0.5f;
+		LUT->MaxError = FMath::Max(LUT->MaxError, (Mid - FVector(Lerped.X, Lerped.Y, Lerped.Z)).GetAbsMax());
+	}
+	if (!IsWithinTolerance(LUT->MaxError, 0.f, (MaxValue - MinValue).GetMax()))
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("RMS curve LUT for %s discarded, max error %f"), *Curve->GetName(),
+		       LUT->MaxError);
+		return nullptr;
+	}
+	return LUT;
+}
+
+void FRMSCurveLUTSet::Build(const UCurveFloat* TimeMappingCurve, const UCurveVector* PathOffsetCurve,
+                            const UCurveFloat* RotationCurve)
+{
+	TimeMapping = FRMSCurveLUT::Build(TimeMappingCurve);
+	PathOffset = FRMSVectorCurveLUT::Build(PathOffsetCurve);
+	Rotation = FRMSCurveLUT::Build(RotationCurve);
+}
+
+float FRMSCurveLUTSet::MapTime(const UCurveFloat* TimeMappingCurve, float Fraction) const
+{
+	if (TimeMapping.IsValid())
+	{
+		return TimeMapping->EvaluateAtFraction(Fraction);
+	}
+	return TimeMappingCurve ? URMSLibrary::EvaluateFloatCurveAtFraction(*TimeMappingCurve, Fraction) : Fraction;
+}
+
+FVector FRMSCurveLUTSet::GetPathOffset(const UCurveVector* PathOffsetCurve, float Fraction) const
+{
+	if (PathOffset.IsValid())
+	{
+		return PathOffset->EvaluateAtFraction(Fraction);
+	}
+	return PathOffsetCurve ? URMSLibrary::EvaluateVectorCurveAtFraction(*PathOffsetCurve, Fraction) : FVector::ZeroVector;
+}
+
+float FRMSCurveLUTSet::GetRotationFraction(const UCurveFloat* RotationCurve, float Fraction) const
+{
+	if (Rotation.IsValid())
+	{
+		return FMath::Clamp(Rotation->Evaluate(Fraction), 0.f, 1.f);
+	}
+	return RotationCurve ? FMath::Clamp(RotationCurve->GetFloatValue(Fraction), 0.f, 1.f) : Fraction;
+}
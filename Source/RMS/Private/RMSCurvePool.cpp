@@ -0,0 +1,148 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+
+#include "RMSCurvePool.h"
+
+#include "RMSTypes.h"
+#include "Curves/CurveVector.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("CurvePool Hits"), STAT_RMS_CurvePool_Hits, STATGROUP_RMS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("CurvePool Misses"), STAT_RMS_CurvePool_Misses, STATGROUP_RMS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("CurvePool Leased"), STAT_RMS_CurvePool_Leased, STATGROUP_RMS);
+
+URMSCurvePool* URMSCurvePool::Get(const UObject* WorldContextObject)
+{
+	const UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<URMSCurvePool>() : nullptr;
+}
+
+UCurveVector* URMSCurvePool::LeaseVectorCurve()
+{
+	CollectFinishedLeases();
+	RecycleCooledCurves();
+
+	UCurveVector* Curve = FreeCurves.Num() > 0 ? FreeCurves.Pop(false).Get() : nullptr;
+	if (Curve)
+	{
+		NumHits++;
+		INC_DWORD_STAT(STAT_RMS_CurvePool_Hits);
+	}
+	else
+	{
+		Curve = NewObject<UCurveVector>(this, NAME_None, RF_Transient);
+		NumMisses++;
+		INC_DWORD_STAT(STAT_RMS_CurvePool_Misses);
+	}
+	LeasedCurves.Add(Curve);
+	INC_DWORD_STAT(STAT_RMS_CurvePool_Leased);
+	return Curve;
+}
+
+void URMSCurvePool::ReturnVectorCurve(UCurveVector* Curve)
+{
+	//重复归还的曲线已经在等待回收
+	if (!Curve || CoolingCurves.ContainsByPredicate([Curve](const FCoolingCurve& Cooling)
+	{
+		return Cooling.Curve == Curve;
+	}))
+	{
+		return;
+	}
+	SourceLeases.RemoveAllSwap([Curve](const FSourceLease& Lease)
+	{
+		return Lease.Curve == Curve;
+	});
+	Recycle(Curve);
+}
+
+void URMSCurvePool::ReturnVectorCurveOnSourceEnd(UCurveVector* Curve, UCharacterMovementComponent* MovementComponent,
+                                                 int32 SourceID)
+{
+	if (!Curve || !LeasedCurves.Contains(Curve))
+	{
+		return;
+	}
+	//Apply失败时直接归还
+	if (!MovementComponent || SourceID <= static_cast<int32>(ERootMotionSourceID::Invalid) || SourceID > MAX_uint16)
+	{
+		ReturnVectorCurve(Curve);
+		return;
+	}
+	FSourceLease& Lease = SourceLeases.AddDefaulted_GetRef();
+	Lease.MovementComponent = MovementComponent;
+	Lease.SourceID = static_cast<uint16>(SourceID);
+	Lease.Curve = Curve;
+}
+
+void URMSCurvePool::GetPoolStats(int32& OutHits, int32& OutMisses, int32& OutFree, int32& OutLeased) const
+{
+	OutHits = NumHits;
+	OutMisses = NumMisses;
+	OutFree = FreeCurves.Num();
+	OutLeased = LeasedCurves.Num();
+}
+
+void URMSCurvePool::CollectFinishedLeases()
+{
+	for (int32 i = SourceLeases.Num() - 1; i >= 0; i--)
+	{
+		const FSourceLease& Lease = SourceLeases[i];
+		UCharacterMovementComponent* MovementComponent = Lease.MovementComponent.Get();
+		if (MovementComponent && MovementComponent->GetRootMotionSourceByID(Lease.SourceID).IsValid())
+		{
+			continue;
+		}
+		UCurveVector* Curve = Lease.Curve;
+		SourceLeases.RemoveAtSwap(i, 1, false);
+		Recycle(Curve);
+	}
+}
+
+void URMSCurvePool::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_RMS_CurvePool_Leased, LeasedCurves.Num());
+	SourceLeases.Empty();
+	CoolingCurves.Empty();
+	LeasedCurves.Empty();
+	FreeCurves.Empty();
+	Super::Deinitialize();
+}
+
+void URMSCurvePool::Recycle(UCurveVector* Curve)
+{
+	if (!LeasedCurves.Contains(Curve))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("URMSCurvePool: %s was not leased from this pool"), *GetNameSafe(Curve));
+		return;
+	}
+	//RMS已经不在CMC里了, 但SavedMove和纠正用的Clone还可能在回放它, 不能马上清空给别的RMS用
+	FCoolingCurve& Cooling = CoolingCurves.AddDefaulted_GetRef();
+	Cooling.Curve = Curve;
+	Cooling.RecycleTime = GetWorld()->GetRealTimeSeconds() + FMath::Max(
+		RMS::CVarRMS_CurvePoolRecycleDelay.GetValueOnGameThread(), 0.f);
+}
+
+void URMSCurvePool::RecycleCooledCurves()
+{
+	const double Now = GetWorld()->GetRealTimeSeconds();
+	int32 NumCooled = 0;
+	for (; NumCooled < CoolingCurves.Num() && CoolingCurves[NumCooled].RecycleTime <= Now; NumCooled++)
+	{
+		UCurveVector* Curve = CoolingCurves[NumCooled].Curve;
+		LeasedCurves.Remove(Curve);
+		DEC_DWORD_STAT(STAT_RMS_CurvePool_Leased);
+		if (FreeCurves.Num() >= RMS::CVarRMS_CurvePoolMaxSize.GetValueOnGameThread())
+		{
+			continue;
+		}
+		for (FRichCurve& FloatCurve : Curve->FloatCurves)
+		{
+			FloatCurve.Reset();
+		}
+		FreeCurves.Add(Curve);
+	}
+	CoolingCurves.RemoveAt(0, NumCooled, false);
+}
@@ -7,31 +7,176 @@
 #include "Curves/CurveFloat.h"
 #include "DrawDebugHelpers.h"
 #include "RMSLibrary.h"
+#include "RMSWarpKernel.h"
+#include "RMSNetQuantize.h"
+#include "Algo/BinarySearch.h"
 #include "GameFramework/Character.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Kismet/KismetMaterialLibrary.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Kismet/KismetSystemLibrary.h"
 
-UE_DISABLE_OPTIMIZATION
+DECLARE_CYCLE_STAT(TEXT("PathMoveToForce Prepare"), STAT_RMS_PathMoveToForce_Prepare, STATGROUP_RMS);
+DECLARE_CYCLE_STAT(TEXT("JumpForce_WithPoints Prepare"), STAT_RMS_JumpForce_WithPoints_Prepare, STATGROUP_RMS);
+DECLARE_CYCLE_STAT(TEXT("MoveToForce_WithRotation Prepare"), STAT_RMS_MoveToForce_WithRotation_Prepare, STATGROUP_RMS);
+DECLARE_CYCLE_STAT(TEXT("MoveToDynamicForce_WithRotation Prepare"), STAT_RMS_MoveToDynamicForce_WithRotation_Prepare,
+                   STATGROUP_RMS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("DynamicMoveTo Updates Applied"), STAT_RMS_DynamicUpdates_Applied, STATGROUP_RMS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("DynamicMoveTo Updates Suppressed"), STAT_RMS_DynamicUpdates_Suppressed, STATGROUP_RMS);
+DECLARE_CYCLE_STAT(TEXT("MoveToForce_Parabola Prepare"), STAT_RMS_MoveToForce_Parabola_Prepare, STATGROUP_RMS);
+DECLARE_CYCLE_STAT(TEXT("AnimWarping Prepare"), STAT_RMS_AnimWarping_Prepare, STATGROUP_RMS);
+DECLARE_CYCLE_STAT(TEXT("AnimWarping_FinalPoint Prepare"), STAT_RMS_AnimWarping_FinalPoint_Prepare, STATGROUP_RMS);
+DECLARE_CYCLE_STAT(TEXT("AnimWarping_MultiTargets Prepare"), STAT_RMS_AnimWarping_MultiTargets_Prepare, STATGROUP_RMS);
+
+RMS_IMPLEMENT_SOURCE_ALLOCATOR(FRootMotionSource_PathMoveToForce)
+RMS_IMPLEMENT_SOURCE_ALLOCATOR(FRootMotionSource_JumpForce_WithPoints)
+RMS_IMPLEMENT_SOURCE_ALLOCATOR(FRootMotionSource_MoveToForce_WithRotation)
+RMS_IMPLEMENT_SOURCE_ALLOCATOR(FRootMotionSource_MoveToDynamicForce_WithRotation)
+RMS_IMPLEMENT_SOURCE_ALLOCATOR(FRootMotionSource_MoveToForce_Parabola)
+RMS_IMPLEMENT_SOURCE_ALLOCATOR(FRootMotionSource_AnimWarping)
+RMS_IMPLEMENT_SOURCE_ALLOCATOR(FRootMotionSource_AnimWarping_FinalPoint)
+RMS_IMPLEMENT_SOURCE_ALLOCATOR(FRootMotionSource_AnimWarping_MultiTargets)
+
+
+namespace
+{
+//CMC可能在工作线程上执行, 每个线程一份
+thread_local FRMSCharacterFrameContext::FScope* GRMSCurrentContextScope = nullptr;
+}
+
+void FRMSCharacterFrameContext::Build(const ACharacter& InCharacter)
+{
+	CharacterKey = FObjectKey(&InCharacter);
+	FrameCounter = GFrameCounter;
+	ActorLocation = InCharacter.GetActorLocation();
+	ActorQuat = InCharacter.GetActorQuat();
+	//没有模型的角色(DoNotCreateDefaultSubobject)用角色的Transform代替, 只有AnimWarping会用到
+	const USkeletalMeshComponent* Mesh = InCharacter.GetMesh();
+	MeshTransform = Mesh ? Mesh->GetComponentTransform() : InCharacter.GetActorTransform();
+	HalfHeight = InCharacter.GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	FootLocation = ActorLocation - FVector(0.f, 0.f, HalfHeight);
+}
+
+FRMSCharacterFrameContext::FScope::FScope(const ACharacter& Character)
+	: Previous(GRMSCurrentContextScope)
+{
+	Context.Build(Character);
+	GRMSCurrentContextScope = this;
+}
+
+FRMSCharacterFrameContext::FScope::~FScope()
+{
+	check(GRMSCurrentContextScope == this);
+	GRMSCurrentContextScope = Previous;
+}
+
+const FRMSCharacterFrameContext& FRMSCharacterFrameContext::Get(const ACharacter& Character)
+{
+	const FObjectKey Key(&Character);
+	for (const FScope* Scope = GRMSCurrentContextScope; Scope; Scope = Scope->Previous)
+	{
+		if (Scope->Context.CharacterKey == Key)
+		{
+			return Scope->Context;
+		}
+	}
+	static thread_local FRMSCharacterFrameContext Context;
+	if (Context.CharacterKey != Key || Context.FrameCounter != GFrameCounter
+		|| !Context.ActorLocation.Equals(Character.GetActorLocation(), 0.f)
+		|| !Context.ActorQuat.Equals(Character.GetActorQuat(), 0.f))
+	{
+		Context.Build(Character);
+	}
+	return Context;
+}
 
 
 #pragma region FRootMotionSource_PathMoveToForce
+FRMSPathMoveToPayloadPtr FRMSPathMoveToPayload::Create(TArray<FRMSPathMoveToData> InPath)
+{
+	TSharedPtr<FRMSPathMoveToPayload, ESPMode::ThreadSafe> Payload = MakeShared<
+		FRMSPathMoveToPayload, ESPMode::ThreadSafe>();
+	Payload->Path = MoveTemp(InPath);
+	const TArray<FRMSPathMoveToData>& Path = Payload->Path;
+
+	Payload->SegmentEndTimes.SetNumUninitialized(Path.Num());
+	float Time = 0.f;
+	for (int32 i = 0; i < Path.Num(); i++)
+	{
+		Time += Path[i].Duration;
+		Payload->SegmentEndTimes[i] = Time;
+	}
+
+	Payload->PathCurveLUTs.SetNum(Path.Num());
+	for (int32 i = 0; i < Path.Num(); i++)
+	{
+		Payload->PathCurveLUTs[i].Build(Path[i].TimeMappingCurve, Path[i].PathOffsetCurve,
+		                                Path[i].RotationSetting.Curve);
+	}
+	Payload->Fingerprint = RMSNetQuantize::HashPath(Path);
+	return Payload;
+}
+
+int32 FRMSPathMoveToPayload::GetSegmentIndexByTime(float Time) const
+{
+	if (SegmentEndTimes.Num() == 0 || Time < 0.f || Time > SegmentEndTimes.Last())
+	{
+		return INDEX_NONE;
+	}
+	//第一个结束时间不小于Time的段, 正好在两段交界时属于前一段
+	return Algo::LowerBound(SegmentEndTimes, Time);
+}
+
+void FRMSPathMoveToPayload::AddReferencedObjects(FReferenceCollector& Collector) const
+{
+	//GC只会把已经销毁的曲线置空, 对所有共享者都成立
+	for (FRMSPathMoveToData& Data : const_cast<TArray<FRMSPathMoveToData>&>(Path))
+	{
+		Collector.AddReferencedObject(Data.PathOffsetCurve);
+		Collector.AddReferencedObject(Data.TimeMappingCurve);
+		Collector.AddReferencedObject(Data.RotationSetting.Curve);
+	}
+}
+
 FRootMotionSource_PathMoveToForce::FRootMotionSource_PathMoveToForce()
 {
 }
 
-FVector FRootMotionSource_PathMoveToForce::GetPathOffsetInWorldSpace(const float MoveFraction, FRMSPathMoveToData Data,
-                                                                     FVector Start) const
+void FRootMotionSource_PathMoveToForce::SetPath(TArray<FRMSPathMoveToData> InPath)
+{
+	Payload = FRMSPathMoveToPayload::Create(MoveTemp(InPath));
+	Index = INDEX_NONE;
+}
+
+const TArray<FRMSPathMoveToData>& FRootMotionSource_PathMoveToForce::GetPath() const
+{
+	static const TArray<FRMSPathMoveToData> EmptyPath;
+	return Payload.IsValid() ? Payload->Path : EmptyPath;
+}
+
+FVector FRootMotionSource_PathMoveToForce::GetPathOffsetInWorldSpace(const float MoveFraction,
+                                                                     const FRMSPathMoveToData& Data,
+                                                                     const FVector& Start,
+                                                                     const FRMSCurveLUTSet* CurveLUTs) const
 {
-	if (Data.PathOffsetCurve)
+	if (Data.PathOffset.IsValid() || Data.PathOffsetCurve)
 	{
 		// Calculate path offset
-		const FVector PathOffsetInFacingSpace = URMSLibrary::EvaluateVectorCurveAtFraction(
-			*Data.PathOffsetCurve, MoveFraction);
+		FVector PathOffsetInFacingSpace;
+		if (Data.PathOffset.IsValid())
+		{
+			PathOffsetInFacingSpace = Data.PathOffset.Evaluate(MoveFraction);
+		}
+		else
+		{
+			PathOffsetInFacingSpace = CurveLUTs
+				                          ? CurveLUTs->GetPathOffset(Data.PathOffsetCurve, MoveFraction)
+				                          : URMSLibrary::EvaluateVectorCurveAtFraction(*Data.PathOffsetCurve, MoveFraction);
+		}
 		FRotator FacingRotation((Data.Target - Start).Rotation());
 		FacingRotation.Pitch = 0.f;
 		return FacingRotation.RotateVector(PathOffsetInFacingSpace);
@@ -42,26 +187,61 @@ FVector FRootMotionSource_PathMoveToForce::GetPathOffsetInWorldSpace(const float
 bool FRootMotionSource_PathMoveToForce::GetPathDataByTime(float InTime, FRMSPathMoveToData& OutCurrData,
                                                           FRMSPathMoveToData& OutLastData) const
 {
-	float Time = 0;
 	if (Duration > 0)
 	{
-		for (auto i : Path)
+		const int32 SegmentIndex = GetSegmentIndexByTime(InTime);
+		if (SegmentIndex != INDEX_NONE)
 		{
-			if (InTime >= Time && InTime <= i.Duration + Time)
+			const TArray<FRMSPathMoveToData>& Path = Payload->Path;
+			OutCurrData = Path[SegmentIndex];
+			if (SegmentIndex > 0)
 			{
-				OutCurrData = i;
-				return true;
-			}
-			else
-			{
-				OutLastData = i;
-				Time += i.Duration;
+				OutLastData = Path[SegmentIndex - 1];
 			}
+			return true;
 		}
 	}
 	return false;
 }
 
+FVector FRootMotionSource_PathMoveToForce::GetSegmentLocation(int32 SegmentIndex, float InTime,
+                                                             float& OutMoveFraction) const
+{
+	const TArray<FRMSPathMoveToData>& Path = Payload->Path;
+	const FRMSPathMoveToData& Data = Path[SegmentIndex];
+	const FVector& SegmentStartLocation = SegmentIndex > 0 ? Path[SegmentIndex - 1].Target : StartLocation;
+	const float SegmentStartTime = SegmentIndex > 0 ? Payload->SegmentEndTimes[SegmentIndex - 1] : 0.f;
+	const FRMSCurveLUTSet* CurveLUTs = GetCurveLUTs(SegmentIndex);
+	OutMoveFraction = (InTime - SegmentStartTime) / Data.Duration;
+	if (Data.TimeMappingCurve)
+	{
+		OutMoveFraction = CurveLUTs
+			                  ? CurveLUTs->MapTime(Data.TimeMappingCurve, OutMoveFraction)
+			                  : URMSLibrary::EvaluateFloatCurveAtFraction(*Data.TimeMappingCurve, OutMoveFraction);
+	}
+	return FMath::Lerp<FVector, float>(SegmentStartLocation, Data.Target, OutMoveFraction) +
+		GetPathOffsetInWorldSpace(OutMoveFraction, Data, SegmentStartLocation, CurveLUTs);
+}
+
+bool FRootMotionSource_PathMoveToForce::SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+                                                         TArrayView<FVector> OutLocations) const
+{
+	if (!Payload.IsValid() || Payload->Path.Num() <= 0)
+	{
+		return false;
+	}
+	const float PathEndTime = Payload->SegmentEndTimes.Last();
+	for (int32 i = 0; i < Times.Num(); i++)
+	{
+		const float Time = FMath::Clamp(Times[i], 0.f, PathEndTime);
+		//夹到路径时间内后一定能找到段
+		const int32 SegmentIndex = FMath::Max(GetSegmentIndexByTime(Time), 0);
+		float MoveFraction;
+		OutLocations[i] = GetSegmentLocation(SegmentIndex, Time, MoveFraction);
+	}
+	return true;
+}
+
 bool FRootMotionSource_PathMoveToForce::UpdateStateFrom(const FRootMotionSource* SourceToTakeStateFrom,
                                                         bool bMarkForSimulatedCatchup)
 {
@@ -77,40 +257,36 @@ void FRootMotionSource_PathMoveToForce::PrepareRootMotion(float SimulationTime,
                                                           const ACharacter& Character,
                                                           const UCharacterMovementComponent& MoveComponent)
 {
+	SCOPE_CYCLE_COUNTER(STAT_RMS_PathMoveToForce_Prepare);
 	RootMotionParams.Clear();
-	if (Path.Num() <= 0)
+	if (!Payload.IsValid() || Payload->Path.Num() <= 0)
 	{
 		return;
 	}
 	if (Duration > SMALL_NUMBER && MovementTickTime > SMALL_NUMBER)
 	{
+		const FRMSCharacterFrameContext& Context = FRMSCharacterFrameContext::Get(Character);
+		const TArray<FRMSPathMoveToData>& Path = Payload->Path;
+		const TArray<float>& SegmentEndTimes = Payload->SegmentEndTimes;
 		const float NextFrame = (GetTime() + SimulationTime);
-		if (Index == -1)
+		if (!Path.IsValidIndex(Index))
 		{
-			LastData.Target = StartLocation;
-			LastData.RotationSetting.TargetRotation = StartRotation;
-
-			CurrData = Path[0];
 			Index = 0;
+			SegmentStartRotation = StartRotation;
 		}
-		if (NextFrame > CurrData.Duration)
-		{
-			if (Index < Path.Num() - 1)
-			{
-				Index ++;
-				LastData = CurrData;
-				CurrData = Path[Index];
-				LastData.RotationSetting.TargetRotation = Character.GetActorRotation();
-			}
-		}
-		float MoveFraction = (NextFrame - LastData.Duration) / CurrData.Duration;
-		if (CurrData.TimeMappingCurve)
+		//只向前移动, 一帧可以跨过多段
+		if (Index < Path.Num() - 1 && NextFrame > SegmentEndTimes[Index])
 		{
-			MoveFraction = URMSLibrary::EvaluateFloatCurveAtFraction(*CurrData.TimeMappingCurve, MoveFraction);
+			const int32 NewIndex = GetSegmentIndexByTime(NextFrame);
+			Index = NewIndex == INDEX_NONE ? Path.Num() - 1 : FMath::Max(Index, NewIndex);
+			SegmentStartRotation = Context.ActorQuat.Rotator();
 		}
-		FVector CurrentTargetLocation = FMath::Lerp<FVector, float>(LastData.Target, CurrData.Target, MoveFraction);
-		CurrentTargetLocation += GetPathOffsetInWorldSpace(MoveFraction, CurrData, LastData.Target);
-		const FVector CurrentLocation = Character.GetActorLocation();
+		const FRMSPathMoveToData& CurrData = Path[Index];
+		const FVector& SegmentStartLocation = Index > 0 ? Path[Index - 1].Target : StartLocation;
+		const FRMSCurveLUTSet* CurveLUTs = GetCurveLUTs(Index);
+		float MoveFraction;
+		const FVector CurrentTargetLocation = GetSegmentLocation(Index, NextFrame, MoveFraction);
+		const FVector& CurrentLocation = Context.ActorLocation;
 		FVector Force = (CurrentTargetLocation - CurrentLocation) / MovementTickTime;
 
 		FRotator RotationDt = FRotator::ZeroRotator;
@@ -119,21 +295,26 @@ void FRootMotionSource_PathMoveToForce::PrepareRootMotion(float SimulationTime,
 			FRotator TargetRotation;
 			if (CurrData.RotationSetting.Mode == ERMSRotationMode::FaceToTarget)
 			{
-				TargetRotation = (CurrData.Target - LastData.Target).Rotation();
+				TargetRotation = (CurrData.Target - SegmentStartLocation).Rotation();
 			}
 			else
 			{
 				TargetRotation = CurrData.RotationSetting.TargetRotation;
 			}
-			const float RotationFraction = FMath::Clamp(MoveFraction * CurrData.RotationSetting.WarpMultiplier,0,1);
-			
-			URMSLibrary::ExtractRotation(RotationDt, Character, LastData.RotationSetting.TargetRotation, TargetRotation, RotationFraction,
-			                             CurrData.RotationSetting.Curve);
+			float RotationFraction = FMath::Clamp(MoveFraction * CurrData.RotationSetting.WarpMultiplier,0,1);
+			UCurveFloat* RotationCurve = CurrData.RotationSetting.Curve;
+			if (CurveLUTs)
+			{
+				RotationFraction = CurveLUTs->GetRotationFraction(RotationCurve, RotationFraction);
+				RotationCurve = nullptr;
+			}
+			URMSLibrary::ExtractRotation(RotationDt, Character, SegmentStartRotation, TargetRotation, RotationFraction,
+			                             RotationCurve);
 		}
 
 
 		// Debug
-#if ROOT_MOTION_DEBUG
+#if RMS_DEBUG
 		if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 		{
 			const FVector LocDiff = MoveComponent.UpdatedComponent->GetComponentLocation() - CurrentLocation;
@@ -177,14 +358,33 @@ bool FRootMotionSource_PathMoveToForce::NetSerialize(FArchive& Ar, UPackageMap*
 		return false;
 	}
 
-	Ar << StartLocation;
-	Ar << Path;
-	Ar << CurrData;
-	Ar << LastData;
-	Ar << Index;
+	if (!RMSNetQuantize::SerializeVersion(Ar))
+	{
+		bOutSuccess = false;
+		return false;
+	}
+	bOutSuccess = RMSNetQuantize::SerializeLocation(Ar, StartLocation);
+	RMSNetQuantize::SerializeRotator(Ar, StartRotation);
+	if (Ar.IsLoading())
+	{
+		//路径没变时继续共享原来的数据
+		TArray<FRMSPathMoveToData> NewPath;
+		bOutSuccess &= RMSNetQuantize::SerializePath(Ar, NewPath, StartLocation);
+		if (!Payload.IsValid() || RMSNetQuantize::HashPath(NewPath) != Payload->Fingerprint)
+		{
+			SetPath(MoveTemp(NewPath));
+		}
+	}
+	else
+	{
+		//保存时不会修改路径
+		bOutSuccess &= RMSNetQuantize::SerializePath(Ar, const_cast<TArray<FRMSPathMoveToData>&>(GetPath()),
+		                                             StartLocation);
+	}
+	RMSNetQuantize::SerializeInt(Ar, Index);
+	RMSNetQuantize::SerializeRotator(Ar, SegmentStartRotation);
 
-	bOutSuccess = true;
-	return true;
+	return !Ar.IsError();
 }
 
 FRootMotionSource* FRootMotionSource_PathMoveToForce::Clone() const
@@ -203,8 +403,18 @@ bool FRootMotionSource_PathMoveToForce::Matches(const FRootMotionSource* Other)
 	// We can cast safely here since in FRootMotionSource::Matches() we ensured ScriptStruct equality
 	const FRootMotionSource_PathMoveToForce* OtherCast = static_cast<const FRootMotionSource_PathMoveToForce*>(Other);
 
-	return StartLocation == OtherCast->StartLocation &&
-		Path == OtherCast->Path && StartRotation == OtherCast->StartRotation;
+	if (!RMSNetQuantize::LocationEquals(StartLocation, OtherCast->StartLocation) ||
+		!RMSNetQuantize::RotatorEquals(StartRotation, OtherCast->StartRotation))
+	{
+		return false;
+	}
+	if (Payload == OtherCast->Payload ||
+		(Payload.IsValid() && OtherCast->Payload.IsValid() && Payload->Fingerprint == OtherCast->Payload->Fingerprint))
+	{
+		return true;
+	}
+	//指纹不同时可能只是正好落在量化边界上, 按误差再比较一次
+	return RMSNetQuantize::PathEquals(GetPath(), OtherCast->GetPath());
 }
 
 bool FRootMotionSource_PathMoveToForce::MatchesAndHasSameState(const FRootMotionSource* Other) const
@@ -213,8 +423,17 @@ bool FRootMotionSource_PathMoveToForce::MatchesAndHasSameState(const FRootMotion
 	{
 		return false;
 	}
+	const FRootMotionSource_PathMoveToForce* OtherCast = static_cast<const FRootMotionSource_PathMoveToForce*>(Other);
 
-	return true;
+	return GetStateFingerprint() == OtherCast->GetStateFingerprint();
+}
+
+uint64 FRootMotionSource_PathMoveToForce::GetStateFingerprint() const
+{
+	RMSNetQuantize::FFingerprint Fingerprint;
+	Fingerprint.AddInt(Index);
+	Fingerprint.AddRotator(SegmentStartRotation);
+	return Fingerprint.Get();
 }
 
 UScriptStruct* FRootMotionSource_PathMoveToForce::GetScriptStruct() const
@@ -230,10 +449,9 @@ FString FRootMotionSource_PathMoveToForce::ToSimpleString() const
 
 void FRootMotionSource_PathMoveToForce::AddReferencedObjects(FReferenceCollector& Collector)
 {
-	for (auto i : Path)
+	if (Payload.IsValid())
 	{
-		Collector.AddReferencedObject(i.PathOffsetCurve);
-		Collector.AddReferencedObject(i.TimeMappingCurve);
+		Payload->AddReferencedObjects(Collector);
 	}
 	FRootMotionSource::AddReferencedObjects(Collector);
 }
@@ -256,10 +474,11 @@ bool FRootMotionSource_JumpForce_WithPoints::UpdateStateFrom(const FRootMotionSo
 
 void FRootMotionSource_JumpForce_WithPoints::PrepareRootMotion(float SimulationTime, float MovementTickTime, const ACharacter& Character, const UCharacterMovementComponent& MoveComponent)
 {
+	SCOPE_CYCLE_COUNTER(STAT_RMS_JumpForce_WithPoints_Prepare);
 	if (!bIsInit)
 	{
-		bIsInit = true;
-		InitPath(Character);
+		//正常在应用时已经初始化, 这里只处理复制过来的RMS
+		InitPath();
 	}
 	RootMotionParams.Clear();
 	
@@ -311,7 +530,7 @@ void FRootMotionSource_JumpForce_WithPoints::PrepareRootMotion(float SimulationT
 		const FVector Force = (TargetRelativeLocation - CurrentRelativeLocation) / MovementTickTime;
 
 		// Debug
-#if ROOT_MOTION_DEBUG
+#if RMS_DEBUG
 		if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 		{
 			const FVector CurrentLocation = Character.GetActorLocation();
@@ -343,6 +562,8 @@ void FRootMotionSource_JumpForce_WithPoints::PrepareRootMotion(float SimulationT
 				SavedHalfwayLocation = HalfwayLocation;
 			}
 			DrawDebugCapsule(Character.GetWorld(), HalfwayLocation + LocDiff, Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(), FQuat::Identity, FColor::White, true, DebugLifetime);
+			DrawDebugSphere(Character.GetWorld(), HalfWayLocation, 15.0, 8, FColor::Green, false, DebugLifetime, 0, 0.1);
+			DrawDebugSphere(Character.GetWorld(), AvgMidPoint, 15.0, 8, FColor::Green, false, DebugLifetime, 0, 0.1);
 
 			// Destination point
 			const FVector DestinationLocation = CurrentLocation + (GetRelativeLocation(1.0f) - CurrentRelativeLocation);
@@ -381,22 +602,38 @@ bool FRootMotionSource_JumpForce_WithPoints::NetSerialize(FArchive& Ar, UPackage
 		return false;
 	}
 
-	
+	if (!RMSNetQuantize::SerializeVersion(Ar))
+	{
+		bOutSuccess = false;
+		return false;
+	}
+	bOutSuccess = RMSNetQuantize::SerializeLocation(Ar, StartLocation);
+	bOutSuccess &= RMSNetQuantize::SerializeOffset(Ar, HalfWayLocation, StartLocation);
+	bOutSuccess &= RMSNetQuantize::SerializeOffset(Ar, TargetLocation, StartLocation);
+	RMSNetQuantize::SerializeRotator(Ar, StartRotation);
+	RMSNetQuantize::SerializeRotationSetting(Ar, RotationSetting);
 	Ar << bDisableTimeout;
-	Ar << TimeMappingCurve;
-
-	bOutSuccess = true;
-	return true;
+	RMSNetQuantize::SerializeAssetCurve(Ar, TimeMappingCurve);
+	if (Ar.IsLoading())
+	{
+		//轨迹参数在下一次Prepare时重新求解
+		bIsInit = false;
+	}
 
+	return !Ar.IsError();
 }
 
 FVector FRootMotionSource_JumpForce_WithPoints::GetPathOffset(float MoveFraction) const
 {
 	FVector PathOffset(FVector::ZeroVector);
-	if (PathOffsetCurve)
+	if (bIsInit)
 	{
-		// Calculate path offset
-		PathOffset = URMSLibrary::EvaluateVectorCurveAtFraction(*PathOffsetCurve, MoveFraction);
+		//经过中间点的折线与经过平均中间点的折线在水平方向上的差, Z是抛物线, 超出0-1时保持端点的值
+		const float Fraction = FMath::Clamp(MoveFraction, 0.f, 1.f);
+		PathOffset.X = GetPolylineDistance2D(HalfWayLocation, Dist1toMid, DistMidto2, Fraction)
+			- GetPolylineDistance2D(AvgMidPoint, Dist1toAvgMid, DistAvgMidto2, Fraction);
+		const float Phi = 2.f * Fraction - 1;
+		PathOffset.Z = -(Phi * Phi) + 1;
 	}
 	else
 	{
@@ -428,6 +665,28 @@ FVector FRootMotionSource_JumpForce_WithPoints::GetRelativeLocation(float MoveFr
 	return FacingRotation.RotateVector(RelativeLocationFacingSpace);
 }
 
+bool FRootMotionSource_JumpForce_WithPoints::SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+                                                              TArrayView<FVector> OutLocations) const
+{
+	if (!bIsInit)
+	{
+		//复制过来还没有Prepare过的RMS, 在副本上初始化轨迹参数
+		FRootMotionSource_JumpForce_WithPoints Initialized(*this);
+		Initialized.InitPath();
+		return Initialized.SampleTrajectory(Character, Times, OutLocations);
+	}
+	for (int32 i = 0; i < Times.Num(); i++)
+	{
+		float MoveFraction = Duration > SMALL_NUMBER ? FMath::Clamp(Times[i] / Duration, 0.f, 1.f) : 1.f;
+		if (TimeMappingCurve)
+		{
+			MoveFraction = URMSLibrary::EvaluateFloatCurveAtFraction(*TimeMappingCurve, MoveFraction);
+		}
+		OutLocations[i] = StartLocation + GetRelativeLocation(MoveFraction);
+	}
+	return true;
+}
+
 bool FRootMotionSource_JumpForce_WithPoints::IsTimeOutEnabled() const
 {
 	if (bDisableTimeout)
@@ -445,7 +704,17 @@ FRootMotionSource* FRootMotionSource_JumpForce_WithPoints::Clone() const
 
 bool FRootMotionSource_JumpForce_WithPoints::Matches(const FRootMotionSource* Other) const
 {
-	return FRootMotionSource::Matches(Other);
+	if (!FRootMotionSource::Matches(Other))
+	{
+		return false;
+	}
+	const FRootMotionSource_JumpForce_WithPoints* OtherCast = static_cast<const
+		FRootMotionSource_JumpForce_WithPoints*>(Other);
+
+	return RMSNetQuantize::LocationEquals(StartLocation, OtherCast->StartLocation) &&
+		RMSNetQuantize::LocationEquals(HalfWayLocation, OtherCast->HalfWayLocation) &&
+		RMSNetQuantize::LocationEquals(TargetLocation, OtherCast->TargetLocation) &&
+		RMSNetQuantize::AssetCurveEquals(TimeMappingCurve, OtherCast->TimeMappingCurve);
 }
 
 bool FRootMotionSource_JumpForce_WithPoints::MatchesAndHasSameState(const FRootMotionSource* Other) const
@@ -454,8 +723,23 @@ bool FRootMotionSource_JumpForce_WithPoints::MatchesAndHasSameState(const FRootM
 	{
 		return false;
 	}
+	const FRootMotionSource_JumpForce_WithPoints* OtherCast = static_cast<const
+		FRootMotionSource_JumpForce_WithPoints*>(Other);
 
-	return true;
+	return GetStateFingerprint() == OtherCast->GetStateFingerprint();
+}
+
+uint64 FRootMotionSource_JumpForce_WithPoints::GetStateFingerprint() const
+{
+	RMSNetQuantize::FFingerprint Fingerprint;
+	Fingerprint.AddInt(bIsInit);
+	if (bIsInit)
+	{
+		//InitPath之后的轨迹参数都由这几个值算出
+		Fingerprint.AddLocation(SavedHalfwayLocation);
+		Fingerprint.AddRotator(SavedRotation);
+	}
+	return Fingerprint.Get();
 }
 
 UScriptStruct* FRootMotionSource_JumpForce_WithPoints::GetScriptStruct() const
@@ -473,96 +757,42 @@ void FRootMotionSource_JumpForce_WithPoints::AddReferencedObjects(FReferenceColl
 {
 	Collector.AddReferencedObject(RotationSetting.Curve);
 	Collector.AddReferencedObject(TimeMappingCurve);
-	Collector.AddReferencedObject(PathOffsetCurve);
 	FRootMotionSource::AddReferencedObjects(Collector);
 }
-void FRootMotionSource_JumpForce_WithPoints::InitPath(const ACharacter& Character)
+float FRootMotionSource_JumpForce_WithPoints::GetPolylineDistance2D(const FVector& MidPoint, float DistToMid,
+                                                                    float DistFromMid, float MoveFraction) const
 {
-	if (RotationSetting.Mode == ERMSRotationMode::None)
+	const float CurrDist = MoveFraction * (DistToMid + DistFromMid);
+	FVector CurrPoint;
+	//在前半段
+	if (CurrDist <= DistToMid)
 	{
-		SavedRotation = StartRotation;
-			//(TargetLocation - StartLocation).Rotation();
+		CurrPoint = DistToMid > SMALL_NUMBER
+			            ? StartLocation + (CurrDist / DistToMid) * (MidPoint - StartLocation)
+			            : StartLocation;
 	}
-	if (!PathOffsetCurve)
+	else
 	{
-		PathOffsetCurve = NewObject<UCurveVector>();
+		CurrPoint = MidPoint + ((CurrDist - DistToMid) / DistFromMid) * (TargetLocation - MidPoint);
 	}
-	const bool bDebug = RMS::CVarRMS_Debug->GetInt()>0;
+	return (CurrPoint - StartLocation).Size2D();
+}
 
-	const float Dist1toMid = (HalfWayLocation - StartLocation).Size();
-	const float DistMidto2 = (HalfWayLocation - TargetLocation).Size();
-	const float Dist1to2 = (StartLocation - TargetLocation).Size();
-	FVector AvgMidPoint = (StartLocation + TargetLocation) * 0.5;
+void FRootMotionSource_JumpForce_WithPoints::InitPath()
+{
+	bIsInit = true;
+	if (RotationSetting.Mode == ERMSRotationMode::None)
+	{
+		SavedRotation = StartRotation;
+	}
+	AvgMidPoint = (StartLocation + TargetLocation) * 0.5;
 	AvgMidPoint.Z = HalfWayLocation.Z;
-	const float Dist1toAvgMid = (AvgMidPoint - StartLocation).Size();
-	const float DistAvgMidto2 = (AvgMidPoint - TargetLocation).Size();
-	SavedDistance = Dist1to2;
+	Dist1toMid = (HalfWayLocation - StartLocation).Size();
+	DistMidto2 = (HalfWayLocation - TargetLocation).Size();
+	Dist1toAvgMid = (AvgMidPoint - StartLocation).Size();
+	DistAvgMidto2 = (AvgMidPoint - TargetLocation).Size();
+	SavedDistance = (StartLocation - TargetLocation).Size();
 	SavedHeight = FMath::Abs(HalfWayLocation.Z - StartLocation.Z);
-	float Duration1toMid = Duration * (Dist1toMid / (Dist1toMid + DistMidto2));
-	float DurationMidto2 = Duration * (DistMidto2 / (Dist1toMid + DistMidto2));
-	if (bDebug)
-	{
-		DrawDebugSphere(Character.GetWorld(), HalfWayLocation,15.0,8,FColor::Green,false,5.0,0,0.1);
-		DrawDebugSphere(Character.GetWorld(), AvgMidPoint,15.0,8,FColor::Green,false,5.0,0,0.1);
-	}
-	FRichCurve XCurve;
-	FRichCurve ZCurve;
-	//根据这个持续时间遍历
-	for (float i = 0; i <= Duration; i += Duration / 64.0)
-	{
-		const float MoveFraction = i / Duration;
-		const float Phi = 2.f * MoveFraction - 1;
-		const float Z = -(Phi * Phi) + 1;
-
-		ZCurve.AddKey(i / Duration, Z);
-		//处理X
-		const float MidFrac = Dist1toMid / (Dist1toMid + DistMidto2);
-		const float CurrDist = MoveFraction * (Dist1toMid + DistMidto2);
-		const float CurrDistAvg = MoveFraction * (Dist1toAvgMid + DistAvgMidto2);
-		//在前半段
-		float X, AvgX;
-		if (CurrDist <= Dist1toMid)
-		{
-			FVector CurrPoint = StartLocation + (CurrDist / Dist1toMid) * (HalfWayLocation - StartLocation);
-			X = (CurrPoint - StartLocation).Size2D();
-			if (bDebug)
-			{
-				DrawDebugSphere(Character.GetWorld(), CurrPoint, 5.0,4,FColor::Green,false,5.0,0,0.5);
-			}
-		}
-		else
-		{
-			FVector CurrPoint = HalfWayLocation + ((CurrDist - Dist1toMid) / DistMidto2) * (TargetLocation - HalfWayLocation);
-			X = (CurrPoint - StartLocation).Size2D();
-			if (bDebug)
-			{
-				DrawDebugSphere(Character.GetWorld(), CurrPoint, 5.0,4,FColor::Green,false,5.0,0,0.5);
-			}
-		}
-		if (CurrDistAvg <= Dist1toAvgMid)
-		{
-			FVector CurrPoint = StartLocation + (CurrDistAvg / Dist1toAvgMid) * (AvgMidPoint - StartLocation);
-			AvgX = (CurrPoint - StartLocation).Size2D();
-			if (bDebug)
-			{
-				DrawDebugSphere(Character.GetWorld(), CurrPoint, 5.0,4,FColor::Red,false,5.0,0,0.5);
-			}
-		}
-		else
-		{
-			FVector CurrPoint = AvgMidPoint + ((CurrDistAvg - Dist1toAvgMid) / DistAvgMidto2) * (TargetLocation - AvgMidPoint);
-			AvgX = (CurrPoint - StartLocation).Size2D();
-			if (bDebug)
-			{
-				DrawDebugSphere(Character.GetWorld(), CurrPoint, 5.0,4,FColor::Red,false,5.0,0,0.5);
-			}
-		}
-		XCurve.AddKey(i / Duration, X - AvgX);
-	}
-	XCurve.AddKey(1.0, 0.0);
-	ZCurve.AddKey(1.0, 0.0);
-	PathOffsetCurve->FloatCurves[0] = XCurve;
-	PathOffsetCurve->FloatCurves[2] = ZCurve;
 }
 
 
@@ -574,88 +804,109 @@ FRootMotionSource_MoveToForce_WithRotation::FRootMotionSource_MoveToForce_WithRo
 {
 }
 
+FVector FRootMotionSource_MoveToForce_WithRotation::GetPathOffsetInWorldSpace(const float MoveFraction) const
+{
+	if (PathOffset.IsValid() || PathOffsetCurve)
+	{
+		const FVector PathOffsetInFacingSpace = PathOffset.IsValid()
+			                                        ? PathOffset.Evaluate(MoveFraction)
+			                                        : CurveLUTs.GetPathOffset(PathOffsetCurve, MoveFraction);
+		FRotator FacingRotation((TargetLocation - StartLocation).Rotation());
+		FacingRotation.Pitch = 0.f;
+		return FacingRotation.RotateVector(PathOffsetInFacingSpace);
+	}
+	return FVector::ZeroVector;
+}
+
+bool FRootMotionSource_MoveToForce_WithRotation::SampleTrajectory(const ACharacter& Character,
+                                                                  TConstArrayView<float> Times,
+                                                                  TArrayView<FVector> OutLocations) const
+{
+	for (int32 i = 0; i < Times.Num(); i++)
+	{
+		const float MoveFraction = Duration > SMALL_NUMBER ? FMath::Clamp(Times[i] / Duration, 0.f, 1.f) : 1.f;
+		OutLocations[i] = GetLocationAtFraction(MoveFraction);
+	}
+	return true;
+}
+
 void FRootMotionSource_MoveToForce_WithRotation::PrepareRootMotion(float SimulationTime, float MovementTickTime,
                                                                    const ACharacter& Character,
                                                                    const UCharacterMovementComponent& MoveComponent)
 {
-	if (RotationSetting.IsWarpRotation())
+	SCOPE_CYCLE_COUNTER(STAT_RMS_MoveToForce_WithRotation_Prepare);
+	//不再回退到FRootMotionSource_MoveToForce, 它不认识PathOffset和查找表
+	RootMotionParams.Clear();
+
+	if (Duration > SMALL_NUMBER && MovementTickTime > SMALL_NUMBER)
 	{
-		RootMotionParams.Clear();
+		const float MoveFraction = (GetTime() + SimulationTime) / Duration;
 
-		if (Duration > SMALL_NUMBER && MovementTickTime > SMALL_NUMBER)
+		const FVector CurrentTargetLocation = GetLocationAtFraction(MoveFraction);
+		const FVector& CurrentLocation = FRMSCharacterFrameContext::Get(Character).ActorLocation;
+		FVector Force = (CurrentTargetLocation - CurrentLocation) / MovementTickTime;
+		FRotator RotationDt = FRotator::ZeroRotator;
+		if (RotationSetting.IsWarpRotation())
 		{
-			const float MoveFraction = (GetTime() + SimulationTime) / Duration;
-
-			FVector CurrentTargetLocation = FMath::Lerp<FVector, float>(StartLocation, TargetLocation, MoveFraction);
-			CurrentTargetLocation += GetPathOffsetInWorldSpace(MoveFraction);
-			const FVector CurrentLocation = Character.GetActorLocation();
-			FVector Force = (CurrentTargetLocation - CurrentLocation) / MovementTickTime;
-			FRotator RotationDt;
 			const FRotator TargetRotation = RotationSetting.Mode == ERMSRotationMode::Custom
-				                 ? RotationSetting.TargetRotation
-				                 : (TargetLocation - StartLocation).Rotation();
-			const float RotationFraction = FMath::Clamp(MoveFraction * RotationSetting.WarpMultiplier,0,1);
-			URMSLibrary::ExtractRotation(RotationDt, Character, StartRotation, TargetRotation, RotationFraction, RotationSetting.Curve);
+				                                ? RotationSetting.TargetRotation
+				                                : (TargetLocation - StartLocation).Rotation();
+			const float RotationFraction = CurveLUTs.GetRotationFraction(
+				RotationSetting.Curve, FMath::Clamp(MoveFraction * RotationSetting.WarpMultiplier, 0, 1));
+			URMSLibrary::ExtractRotation(RotationDt, Character, StartRotation, TargetRotation, RotationFraction, nullptr);
+		}
 
-			if (bRestrictSpeedToExpected && !Force.IsNearlyZero(KINDA_SMALL_NUMBER))
-			{
-				// Calculate expected current location (if we didn't have collision and moved exactly where our velocity should have taken us)
-				const float PreviousMoveFraction = GetTime() / Duration;
-				FVector CurrentExpectedLocation = FMath::Lerp<FVector, float>(
-					StartLocation, TargetLocation, PreviousMoveFraction);
-				CurrentExpectedLocation += GetPathOffsetInWorldSpace(PreviousMoveFraction);
-
-				// Restrict speed to the expected speed, allowing some small amount of error
-				const FVector ExpectedForce = (CurrentTargetLocation - CurrentExpectedLocation) / MovementTickTime;
-				const float ExpectedSpeed = ExpectedForce.Size();
-				const float CurrentSpeedSqr = Force.SizeSquared();
-
-				const float ErrorAllowance = 0.5f; // in cm/s
-				if (CurrentSpeedSqr > FMath::Square(ExpectedSpeed + ErrorAllowance))
-				{
-					Force.Normalize();
-					Force *= ExpectedSpeed;
-				}
-			}
+		if (bRestrictSpeedToExpected && !Force.IsNearlyZero(KINDA_SMALL_NUMBER))
+		{
+			// Calculate expected current location (if we didn't have collision and moved exactly where our velocity should have taken us)
+			const float PreviousMoveFraction = GetTime() / Duration;
+			const FVector CurrentExpectedLocation = GetLocationAtFraction(PreviousMoveFraction);
+
+			// Restrict speed to the expected speed, allowing some small amount of error
+			const FVector ExpectedForce = (CurrentTargetLocation - CurrentExpectedLocation) / MovementTickTime;
+			const float ExpectedSpeed = ExpectedForce.Size();
+			const float CurrentSpeedSqr = Force.SizeSquared();
 
-			// Debug
-#if ROOT_MOTION_DEBUG
-			if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
+			const float ErrorAllowance = 0.5f; // in cm/s
+			if (CurrentSpeedSqr > FMath::Square(ExpectedSpeed + ErrorAllowance))
 			{
-				const FVector LocDiff = MoveComponent.UpdatedComponent->GetComponentLocation() - CurrentLocation;
-				const float DebugLifetime = 2.0f;
-
-				// Current
-				DrawDebugCapsule(Character.GetWorld(), MoveComponent.UpdatedComponent->GetComponentLocation(),
-				                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
-				                 FQuat::Identity, FColor::Red, false, DebugLifetime);
-
-				// Current Target
-				DrawDebugCapsule(Character.GetWorld(), CurrentTargetLocation + LocDiff,
-				                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
-				                 FQuat::Identity, FColor::Green, false, DebugLifetime);
-
-				// Target
-				DrawDebugCapsule(Character.GetWorld(), TargetLocation + LocDiff,
-				                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
-				                 FQuat::Identity, FColor::Blue, false, DebugLifetime);
-
-				// Force
-				DrawDebugLine(Character.GetWorld(), CurrentLocation, CurrentLocation + Force, FColor::Blue, false,
-				              DebugLifetime);
+				Force.Normalize();
+				Force *= ExpectedSpeed;
 			}
-#endif
+		}
+
+		// Debug
+#if RMS_DEBUG
+		if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
+		{
+			const FVector LocDiff = MoveComponent.UpdatedComponent->GetComponentLocation() - CurrentLocation;
+			const float DebugLifetime = 2.0f;
+
+			// Current
+			DrawDebugCapsule(Character.GetWorld(), MoveComponent.UpdatedComponent->GetComponentLocation(),
+			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
+			                 FQuat::Identity, FColor::Red, false, DebugLifetime);
 
-			FTransform NewTransform(RotationDt, Force);
-			RootMotionParams.Set(NewTransform);
+			// Current Target
+			DrawDebugCapsule(Character.GetWorld(), CurrentTargetLocation + LocDiff,
+			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
+			                 FQuat::Identity, FColor::Green, false, DebugLifetime);
+
+			// Target
+			DrawDebugCapsule(Character.GetWorld(), TargetLocation + LocDiff,
+			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
+			                 FQuat::Identity, FColor::Blue, false, DebugLifetime);
+
+			// Force
+			DrawDebugLine(Character.GetWorld(), CurrentLocation, CurrentLocation + Force, FColor::Blue, false,
+			              DebugLifetime);
 		}
-		SetTime(GetTime() + SimulationTime);
-	}
-	else
-	{
-		FRootMotionSource_MoveToForce::PrepareRootMotion(SimulationTime, MovementTickTime, Character,
-		                                                 MoveComponent);
+#endif
+
+		FTransform NewTransform(RotationDt, Force);
+		RootMotionParams.Set(NewTransform);
 	}
+	SetTime(GetTime() + SimulationTime);
 }
 
 UScriptStruct* FRootMotionSource_MoveToForce_WithRotation::GetScriptStruct() const
@@ -675,7 +926,7 @@ void FRootMotionSource_MoveToForce_WithRotation::AddReferencedObjects(FReference
 	Collector.AddReferencedObject(RotationSetting.Curve);
 	
 	
-	FRootMotionSource::AddReferencedObjects(Collector);
+	FRootMotionSource_MoveToForce::AddReferencedObjects(Collector);
 }
 
 bool FRootMotionSource_MoveToForce_WithRotation::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
@@ -684,208 +935,507 @@ bool FRootMotionSource_MoveToForce_WithRotation::NetSerialize(FArchive& Ar, UPac
 	{
 		return false;
 	}
-
-	Ar << StartLocation;
-	Ar << RotationSetting;
-	Ar << StartLocation; // TODO-RootMotionSource: Quantization
-	Ar << TargetLocation; // TODO-RootMotionSource: Quantization
+
+	if (!RMSNetQuantize::SerializeVersion(Ar))
+	{
+		bOutSuccess = false;
+		return false;
+	}
+	bOutSuccess = RMSNetQuantize::SerializeLocation(Ar, StartLocation);
+	bOutSuccess &= RMSNetQuantize::SerializeOffset(Ar, TargetLocation, StartLocation);
+	RMSNetQuantize::SerializeRotator(Ar, StartRotation);
+	RMSNetQuantize::SerializeRotationSetting(Ar, RotationSetting);
+	Ar << bRestrictSpeedToExpected;
+	RMSNetQuantize::SerializePathOffset(Ar, PathOffsetCurve, PathOffset);
+	if (Ar.IsLoading())
+	{
+		UpdatePathOffsetFingerprint();
+	}
+
+	return !Ar.IsError();
+}
+
+FRootMotionSource* FRootMotionSource_MoveToForce_WithRotation::Clone() const
+{
+	FRootMotionSource_MoveToForce_WithRotation* CopyPtr = new FRootMotionSource_MoveToForce_WithRotation(*this);
+	return CopyPtr;
+}
+
+void FRootMotionSource_MoveToForce_WithRotation::UpdatePathOffsetFingerprint()
+{
+	RMSNetQuantize::FFingerprint Fingerprint;
+	Fingerprint.AddPathOffset(PathOffsetCurve, PathOffset);
+	PathOffsetFingerprint = Fingerprint.Get();
+}
+
+bool FRootMotionSource_MoveToForce_WithRotation::Matches(const FRootMotionSource* Other) const
+{
+	if (!FRootMotionSource::Matches(Other))
+	{
+		return false;
+	}
+	const FRootMotionSource_MoveToForce_WithRotation* OtherCast = static_cast<const FRootMotionSource_MoveToForce_WithRotation*>(Other);
+
+	if (!RMSNetQuantize::RotationSettingEquals(RotationSetting, OtherCast->RotationSetting) ||
+		!RMSNetQuantize::RotatorEquals(StartRotation, OtherCast->StartRotation))
+	{
+		return false;
+	}
+	if (PathOffsetFingerprint != 0 && PathOffsetFingerprint == OtherCast->PathOffsetFingerprint)
+	{
+		return true;
+	}
+	//指纹不同时可能只是正好落在量化边界上, 按误差再比较一次
+	return RMSNetQuantize::PathOffsetEquals(PathOffsetCurve, PathOffset, OtherCast->PathOffsetCurve,
+	                                        OtherCast->PathOffset);
+}
+
+bool FRootMotionSource_MoveToForce_WithRotation::MatchesAndHasSameState(const FRootMotionSource* Other) const
+{
+	if (!FRootMotionSource::MatchesAndHasSameState(Other))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool FRootMotionSource_MoveToForce_WithRotation::UpdateStateFrom(const FRootMotionSource* SourceToTakeStateFrom, bool bMarkForSimulatedCatchup)
+{
+	if (!FRootMotionSource::UpdateStateFrom(SourceToTakeStateFrom, bMarkForSimulatedCatchup))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+FVector FRootMotionSource_MoveToDynamicForce_WithRotation::GetPathOffsetInWorldSpace(const float MoveFraction) const
+{
+	if (PathOffset.IsValid() || PathOffsetCurve)
+	{
+		const FVector PathOffsetInFacingSpace = PathOffset.IsValid()
+			                                        ? PathOffset.Evaluate(MoveFraction)
+			                                        : CurveLUTs.GetPathOffset(PathOffsetCurve, MoveFraction);
+		FRotator FacingRotation((TargetLocation - StartLocation).Rotation());
+		FacingRotation.Pitch = 0.f;
+		return FacingRotation.RotateVector(PathOffsetInFacingSpace);
+	}
+	return FVector::ZeroVector;
+}
+
+void FRootMotionSource_MoveToDynamicForce_WithRotation::PrepareRootMotion(float SimulationTime, float MovementTickTime,
+                                                                          const ACharacter& Character,
+                                                                          const UCharacterMovementComponent&
+                                                                          MoveComponent)
+{
+	SCOPE_CYCLE_COUNTER(STAT_RMS_MoveToDynamicForce_WithRotation_Prepare);
+	//不再回退到FRootMotionSource_MoveToDynamicForce, 它不认识PathOffset和查找表
+	PrepareMoveTo(SimulationTime, MovementTickTime, Character, MoveComponent);
+}
+
+bool FRootMotionSource_MoveToDynamicForce_WithRotation::SampleTrajectory(const ACharacter& Character,
+                                                                         TConstArrayView<float> Times,
+                                                                         TArrayView<FVector> OutLocations) const
+{
+	//Parabola通过GetTargetLocationAtFraction加上高度
+	for (int32 i = 0; i < Times.Num(); i++)
+	{
+		const float TimeFraction = Duration > SMALL_NUMBER ? FMath::Clamp(Times[i] / Duration, 0.f, 1.f) : 1.f;
+		OutLocations[i] = GetTargetLocationAtFraction(CurveLUTs.MapTime(TimeMappingCurve, TimeFraction));
+	}
+	return true;
+}
+
+void FRootMotionSource_MoveToDynamicForce_WithRotation::Retarget(const FVector& NewStartLocation,
+                                                                 const FRotator& NewStartRotation,
+                                                                 const FVector& NewTargetLocation, float NewDuration,
+                                                                 bool bAuthority)
+{
+	SetTime(0);
+	Duration = NewDuration;
+	StartLocation = NewStartLocation;
+	StartRotation = NewStartRotation;
+	SetTargetLocation(NewTargetLocation);
+	bRetargeted = true;
+	if (bAuthority)
+	{
+		//0留给应用时的那一段
+		RetargetSequence = RetargetSequence == MAX_uint8 ? 1 : RetargetSequence + 1;
+	}
+	//客户端保留服务器的序号, 服务器的记录到达前用本地预测的这一段
+}
+
+bool FRootMotionSource_MoveToDynamicForce_WithRotation::RequestTargetLocation(const ACharacter& Character,
+                                                                              const FVector& NewTargetLocation)
+{
+	const FVector& CompareLocation = bHasPendingTarget ? PendingTargetLocation : TargetLocation;
+	if (FVector::DistSquared(NewTargetLocation, CompareLocation) <= FMath::Square(UpdatePolicy.DeadBand))
+	{
+		SuppressedUpdates++;
+		INC_DWORD_STAT(STAT_RMS_DynamicUpdates_Suppressed);
+		return false;
+	}
+	if (bHasPendingTarget)
+	{
+		//被新的请求覆盖
+		SuppressedUpdates++;
+		INC_DWORD_STAT(STAT_RMS_DynamicUpdates_Suppressed);
+	}
+	PendingTargetLocation = NewTargetLocation;
+	bHasPendingTarget = true;
+	if (!UpdatePolicy.bCoalescePerFrame)
+	{
+		ApplyPendingUpdate(Character);
+	}
+	return true;
+}
+
+bool FRootMotionSource_MoveToDynamicForce_WithRotation::RequestDuration(const ACharacter& Character, float NewDuration)
+{
+	const float CompareDuration = bHasPendingDuration ? PendingDuration : Duration;
+	if (NewDuration <= GetTime() || FMath::IsNearlyEqual(NewDuration, CompareDuration, KINDA_SMALL_NUMBER))
+	{
+		SuppressedUpdates++;
+		INC_DWORD_STAT(STAT_RMS_DynamicUpdates_Suppressed);
+		return false;
+	}
+	if (bHasPendingDuration)
+	{
+		SuppressedUpdates++;
+		INC_DWORD_STAT(STAT_RMS_DynamicUpdates_Suppressed);
+	}
+	PendingDuration = NewDuration;
+	bHasPendingDuration = true;
+	if (!UpdatePolicy.bCoalescePerFrame)
+	{
+		ApplyPendingUpdate(Character);
+	}
+	return true;
+}
+
+bool FRootMotionSource_MoveToDynamicForce_WithRotation::ApplyPendingUpdate(const ACharacter& Character)
+{
+	//Retarget会把时间归零, 所以当前时间就是距离上一次Retarget的时间, 第一段从应用时开始算
+	if (bRetargeted && GetTime() < UpdatePolicy.MinInterval)
+	{
+		return false;
+	}
+	const float EndTime = bHasPendingDuration ? PendingDuration : Duration;
+	const FVector NewTargetLocation = bHasPendingTarget ? PendingTargetLocation : TargetLocation;
+	bHasPendingTarget = false;
+	bHasPendingDuration = false;
+	if (EndTime <= GetTime())
+	{
+		//已经结束了, 没有可以重新设定的部分
+		SuppressedUpdates++;
+		INC_DWORD_STAT(STAT_RMS_DynamicUpdates_Suppressed);
+		return false;
+	}
+	//为了防止跳跃, 需要从当前位置和时间重新开始
+	const FRMSCharacterFrameContext& Context = FRMSCharacterFrameContext::Get(Character);
+	Retarget(Context.ActorLocation, Context.ActorQuat.Rotator(), NewTargetLocation, EndTime - GetTime(),
+	         Character.HasAuthority());
+	AppliedUpdates++;
+	INC_DWORD_STAT(STAT_RMS_DynamicUpdates_Applied);
+	return true;
+}
+
+bool FRootMotionSource_MoveToDynamicForce_WithRotation::UpdateStateFrom(const FRootMotionSource* SourceToTakeStateFrom,
+                                                                        bool bMarkForSimulatedCatchup)
+{
+	if (!FRootMotionSource_MoveToDynamicForce::UpdateStateFrom(SourceToTakeStateFrom, bMarkForSimulatedCatchup))
+	{
+		return false;
+	}
+	const FRootMotionSource_MoveToDynamicForce_WithRotation* OtherCast = static_cast<const
+		FRootMotionSource_MoveToDynamicForce_WithRotation*>(SourceToTakeStateFrom);
+	if (OtherCast->RetargetSequence != RetargetSequence)
+	{
+		//序号只由服务器增加, 不同说明服务器重新设定了目标, 本地的这一段(包括本地的预测)已经过时
+		Duration = OtherCast->Duration;
+		SetTargetLocation(OtherCast->TargetLocation);
+		StartLocation = OtherCast->StartLocation;
+		StartRotation = OtherCast->StartRotation;
+		RetargetSequence = OtherCast->RetargetSequence;
+		bRetargeted = RetargetSequence != 0;
+	}
+	return true;
+}
+
+void FRootMotionSource_MoveToDynamicForce_WithRotation::PrepareMoveTo(float SimulationTime, float MovementTickTime,
+                                                                      const ACharacter& Character,
+                                                                      const UCharacterMovementComponent& MoveComponent)
+{
+	RootMotionParams.Clear();
+
+	//同一帧里的多次请求只在这里应用最后一个
+	if (HasPendingUpdate())
+	{
+		ApplyPendingUpdate(Character);
+	}
+
+	if (Duration > SMALL_NUMBER && MovementTickTime > SMALL_NUMBER)
+	{
+		const float MoveFraction = CurveLUTs.MapTime(TimeMappingCurve, (GetTime() + SimulationTime) / Duration);
+
+		const FVector CurrentTargetLocation = GetTargetLocationAtFraction(MoveFraction);
+
+		const FVector& CurrentLocation = FRMSCharacterFrameContext::Get(Character).ActorLocation;
+
+		FVector Force = (CurrentTargetLocation - CurrentLocation) / MovementTickTime;
+
+		FRotator RotationDt = FRotator::ZeroRotator;
+		if (RotationSetting.IsWarpRotation())
+		{
+			FRotator TargetRotation = RotationSetting.Mode == ERMSRotationMode::Custom
+				                          ? RotationSetting.TargetRotation
+				                          : (TargetLocation - StartLocation).Rotation();
+			const float RotationFraction = CurveLUTs.GetRotationFraction(
+				RotationSetting.Curve, FMath::Clamp(MoveFraction * RotationSetting.WarpMultiplier, 0, 1));
+			URMSLibrary::ExtractRotation(RotationDt, Character, StartRotation, TargetRotation, RotationFraction, nullptr);
+		}
+
+		if (bRestrictSpeedToExpected && !Force.IsNearlyZero(KINDA_SMALL_NUMBER))
+		{
+			// Calculate expected current location (if we didn't have collision and moved exactly where our velocity should have taken us)
+			const float PreviousMoveFraction = CurveLUTs.MapTime(TimeMappingCurve, GetTime() / Duration);
+
+			const FVector CurrentExpectedLocation = GetTargetLocationAtFraction(PreviousMoveFraction);
+
+			// Restrict speed to the expected speed, allowing some small amount of error
+			const FVector ExpectedForce = (CurrentTargetLocation - CurrentExpectedLocation) / MovementTickTime;
+			const float ExpectedSpeed = ExpectedForce.Size();
+			const float CurrentSpeedSqr = Force.SizeSquared();
+
+			const float ErrorAllowance = 0.5f; // in cm/s
+			if (CurrentSpeedSqr > FMath::Square(ExpectedSpeed + ErrorAllowance))
+			{
+				Force.Normalize();
+				Force *= ExpectedSpeed;
+			}
+		}
+
+		// Debug
+#if RMS_DEBUG
+		if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
+		{
+			const FVector LocDiff = MoveComponent.UpdatedComponent->GetComponentLocation() - CurrentLocation;
+			const float DebugLifetime = 2.0f;
+
+			// Current
+			DrawDebugCapsule(Character.GetWorld(), MoveComponent.UpdatedComponent->GetComponentLocation(),
+			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
+			                 FQuat::Identity, FColor::Red, false, DebugLifetime);
+
+			// Current Target
+			DrawDebugCapsule(Character.GetWorld(), CurrentTargetLocation + LocDiff,
+			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
+			                 FQuat::Identity, FColor::Green, false, DebugLifetime);
+
+			// Target
+			DrawDebugCapsule(Character.GetWorld(), TargetLocation + LocDiff,
+			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
+			                 FQuat::Identity, FColor::Blue, false, DebugLifetime);
+
+			// Force
+			DrawDebugLine(Character.GetWorld(), CurrentLocation, CurrentLocation + Force, FColor::Blue, false,
+			              DebugLifetime);
+		}
+#endif
+
+		FTransform NewTransform(RotationDt, Force);
+		RootMotionParams.Set(NewTransform);
+	}
+	SetTime(GetTime() + SimulationTime);
+}
+
+UScriptStruct* FRootMotionSource_MoveToDynamicForce_WithRotation::GetScriptStruct() const
+{
+	return FRootMotionSource_MoveToDynamicForce_WithRotation::StaticStruct();
+}
+
+bool FRootMotionSource_MoveToDynamicForce_WithRotation::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+
+	if (!FRootMotionSource::NetSerialize(Ar, Map, bOutSuccess))
+	{
+		return false;
+	}
+	if (!RMSNetQuantize::SerializeVersion(Ar))
+	{
+		bOutSuccess = false;
+		return false;
+	}
+	Ar << RetargetSequence;
+	if (RetargetSequence == 0)
+	{
+		RMSNetQuantize::SerializeRotator(Ar, StartRotation);
+		bOutSuccess = RMSNetQuantize::SerializeLocation(Ar, StartLocation);
+		bOutSuccess &= RMSNetQuantize::SerializeOffset(Ar, InitialTargetLocation, StartLocation);
+		bOutSuccess &= RMSNetQuantize::SerializeOffset(Ar, TargetLocation, StartLocation);
+	}
+	else
+	{
+		//Retarget之后只发送记录: 序号, 起始旋转, 新目标和相对新目标的起点, 时间和时长在父类里
+		//没有每个连接的基准, 接收端直接使用服务器的这一段, 不依赖之前收到的数据
+		RMSNetQuantize::SerializeRotator(Ar, StartRotation);
+		bOutSuccess = RMSNetQuantize::SerializeLocation(Ar, TargetLocation);
+		bOutSuccess &= RMSNetQuantize::SerializeOffset(Ar, StartLocation, TargetLocation);
+	}
+	if (Ar.IsLoading())
+	{
+		bRetargeted = RetargetSequence != 0;
+	}
 	Ar << bRestrictSpeedToExpected;
-	//Ar << PathOffsetCurve;
+	RMSNetQuantize::SerializeRotationSetting(Ar, RotationSetting);
+	RMSNetQuantize::SerializePathOffset(Ar, PathOffsetCurve, PathOffset);
+	if (Ar.IsLoading())
+	{
+		UpdatePathOffsetFingerprint();
+	}
+	RMSNetQuantize::SerializeAssetCurve(Ar, TimeMappingCurve);
 
-	bOutSuccess = true;
-	return true;
+	return !Ar.IsError();
 }
 
-FRootMotionSource* FRootMotionSource_MoveToForce_WithRotation::Clone() const
+FRootMotionSource* FRootMotionSource_MoveToDynamicForce_WithRotation::Clone() const
 {
-	FRootMotionSource_MoveToForce_WithRotation* CopyPtr = new FRootMotionSource_MoveToForce_WithRotation(*this);
+	FRootMotionSource_MoveToDynamicForce_WithRotation* CopyPtr = new FRootMotionSource_MoveToDynamicForce_WithRotation(*this);
+	CopyPtr->ClearPendingUpdate();
 	return CopyPtr;
 }
 
-bool FRootMotionSource_MoveToForce_WithRotation::Matches(const FRootMotionSource* Other) const
+void FRootMotionSource_MoveToDynamicForce_WithRotation::UpdatePathOffsetFingerprint()
+{
+	RMSNetQuantize::FFingerprint Fingerprint;
+	Fingerprint.AddPathOffset(PathOffsetCurve, PathOffset);
+	PathOffsetFingerprint = Fingerprint.Get();
+}
+
+bool FRootMotionSource_MoveToDynamicForce_WithRotation::Matches(const FRootMotionSource* Other) const
 {
 	if (!FRootMotionSource::Matches(Other))
 	{
 		return false;
 	}
-	const FRootMotionSource_MoveToForce_WithRotation* OtherCast = static_cast<const FRootMotionSource_MoveToForce_WithRotation*>(Other);
-
-	return RotationSetting == OtherCast->RotationSetting && StartRotation == OtherCast->StartRotation;
-}
+	const FRootMotionSource_MoveToDynamicForce_WithRotation* OtherCast = static_cast<const FRootMotionSource_MoveToDynamicForce_WithRotation*>(Other);
 
-bool FRootMotionSource_MoveToForce_WithRotation::MatchesAndHasSameState(const FRootMotionSource* Other) const
-{
-	if (!FRootMotionSource::MatchesAndHasSameState(Other))
+	//StartRotation随Retarget改变, 在GetStateFingerprint里比较
+	if (!RMSNetQuantize::RotationSettingEquals(RotationSetting, OtherCast->RotationSetting))
 	{
 		return false;
 	}
-
-	return true;
+	if (PathOffsetFingerprint != 0 && PathOffsetFingerprint == OtherCast->PathOffsetFingerprint)
+	{
+		return true;
+	}
+	//指纹不同时可能只是正好落在量化边界上, 按误差再比较一次
+	return RMSNetQuantize::PathOffsetEquals(PathOffsetCurve, PathOffset, OtherCast->PathOffsetCurve,
+	                                        OtherCast->PathOffset);
 }
 
-bool FRootMotionSource_MoveToForce_WithRotation::UpdateStateFrom(const FRootMotionSource* SourceToTakeStateFrom, bool bMarkForSimulatedCatchup)
+bool FRootMotionSource_MoveToDynamicForce_WithRotation::MatchesAndHasSameState(const FRootMotionSource* Other) const
 {
-	if (!FRootMotionSource::UpdateStateFrom(SourceToTakeStateFrom, bMarkForSimulatedCatchup))
+	if (!FRootMotionSource::MatchesAndHasSameState(Other))
 	{
 		return false;
 	}
+	const FRootMotionSource_MoveToDynamicForce_WithRotation* OtherCast = static_cast<const
+		FRootMotionSource_MoveToDynamicForce_WithRotation*>(Other);
 
-	return true;
+	return GetStateFingerprint() == OtherCast->GetStateFingerprint();
 }
 
-void FRootMotionSource_MoveToDynamicForce_WithRotation::PrepareRootMotion(float SimulationTime, float MovementTickTime,
-                                                                          const ACharacter& Character,
-                                                                          const UCharacterMovementComponent&
-                                                                          MoveComponent)
+uint64 FRootMotionSource_MoveToDynamicForce_WithRotation::GetStateFingerprint() const
 {
-	if (RotationSetting.IsWarpRotation())
+	//Time和Status在父类里比较
+	RMSNetQuantize::FFingerprint Fingerprint;
+	Fingerprint.AddInt(RetargetSequence);
+	Fingerprint.AddTime(Duration);
+	Fingerprint.AddLocation(StartLocation);
+	Fingerprint.AddLocation(TargetLocation);
+	Fingerprint.AddRotator(StartRotation);
+	return Fingerprint.Get();
+}
+//*******************************************************************
+FVector FRootMotionSource_MoveToForce_Parabola::GetParabolaLocation(const FVector& Start, const FVector& Target,
+                                                                  const UCurveFloat* Curve, float Height,
+                                                                  float MoveFraction)
+{
+	FVector Location = FMath::Lerp<FVector, float>(Start, Target, MoveFraction);
+	if (Curve)
 	{
-		RootMotionParams.Clear();
-
-		if (Duration > SMALL_NUMBER && MovementTickTime > SMALL_NUMBER)
-		{
-			float MoveFraction = (GetTime() + SimulationTime) / Duration;
-
-			if (TimeMappingCurve)
-			{
-				MoveFraction = URMSLibrary::EvaluateFloatCurveAtFraction(*TimeMappingCurve, MoveFraction);
-			}
-
-			FVector CurrentTargetLocation = FMath::Lerp<FVector, float>(StartLocation, TargetLocation, MoveFraction);
-			CurrentTargetLocation += GetPathOffsetInWorldSpace(MoveFraction);
-
-			const FVector CurrentLocation = Character.GetActorLocation();
-
-			FVector Force = (CurrentTargetLocation - CurrentLocation) / MovementTickTime;
-
-			FRotator RotationDt;
-			FRotator TargetRotation = RotationSetting.Mode == ERMSRotationMode::Custom
-				                          ? RotationSetting.TargetRotation
-				                          : (TargetLocation - StartLocation).Rotation();
-			const float RotationFraction = FMath::Clamp(MoveFraction * RotationSetting.WarpMultiplier,0,1);
-			URMSLibrary::ExtractRotation(RotationDt, Character, StartRotation, TargetRotation, RotationFraction,
-			                             RotationSetting.Curve);
-
-
-			if (bRestrictSpeedToExpected && !Force.IsNearlyZero(KINDA_SMALL_NUMBER))
-			{
-				// Calculate expected current location (if we didn't have collision and moved exactly where our velocity should have taken us)
-				float PreviousMoveFraction = GetTime() / Duration;
-				if (TimeMappingCurve)
-				{
-					PreviousMoveFraction = URMSLibrary::EvaluateFloatCurveAtFraction(
-						*TimeMappingCurve, PreviousMoveFraction);
-				}
-
-				FVector CurrentExpectedLocation = FMath::Lerp<FVector, float>(
-					StartLocation, TargetLocation, PreviousMoveFraction);
-				CurrentExpectedLocation += GetPathOffsetInWorldSpace(PreviousMoveFraction);
-
-				// Restrict speed to the expected speed, allowing some small amount of error
-				const FVector ExpectedForce = (CurrentTargetLocation - CurrentExpectedLocation) / MovementTickTime;
-				const float ExpectedSpeed = ExpectedForce.Size();
-				const float CurrentSpeedSqr = Force.SizeSquared();
-
-				const float ErrorAllowance = 0.5f; // in cm/s
-				if (CurrentSpeedSqr > FMath::Square(ExpectedSpeed + ErrorAllowance))
-				{
-					Force.Normalize();
-					Force *= ExpectedSpeed;
-				}
-			}
-
-			// Debug
-#if ROOT_MOTION_DEBUG
-			if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
-			{
-				const FVector LocDiff = MoveComponent.UpdatedComponent->GetComponentLocation() - CurrentLocation;
-				const float DebugLifetime = 2.0f;
-
-				// Current
-				DrawDebugCapsule(Character.GetWorld(), MoveComponent.UpdatedComponent->GetComponentLocation(),
-				                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
-				                 FQuat::Identity, FColor::Red, false, DebugLifetime);
-
-				// Current Target
-				DrawDebugCapsule(Character.GetWorld(), CurrentTargetLocation + LocDiff,
-				                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
-				                 FQuat::Identity, FColor::Green, false, DebugLifetime);
-
-				// Target
-				DrawDebugCapsule(Character.GetWorld(), TargetLocation + LocDiff,
-				                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
-				                 FQuat::Identity, FColor::Blue, false, DebugLifetime);
-
-				// Force
-				DrawDebugLine(Character.GetWorld(), CurrentLocation, CurrentLocation + Force, FColor::Blue, false,
-				              DebugLifetime);
-			}
-#endif
-
-			FTransform NewTransform(RotationDt, Force);
-			RootMotionParams.Set(NewTransform);
-		}
-		SetTime(GetTime() + SimulationTime);
+		//与原来的预测一样按曲线的时间范围取值, 不要求曲线定义在[0, 1]上
+		Location.Z = Start.Z + (Target.Z - Start.Z) * URMSLibrary::EvaluateFloatCurveAtFraction(*Curve, MoveFraction);
 	}
 	else
 	{
-		FRootMotionSource_MoveToDynamicForce::PrepareRootMotion(SimulationTime, MovementTickTime, Character,
-		                                                        MoveComponent);
+		Location.Z += 4.f * Height * MoveFraction * (1.f - MoveFraction);
 	}
+	return Location;
 }
 
-UScriptStruct* FRootMotionSource_MoveToDynamicForce_WithRotation::GetScriptStruct() const
+void FRootMotionSource_MoveToForce_Parabola::PrepareRootMotion(float SimulationTime, float MovementTickTime,
+                                                               const ACharacter& Character,
+                                                               const UCharacterMovementComponent& MoveComponent)
 {
-	return FRootMotionSource_MoveToDynamicForce_WithRotation::StaticStruct();
+	SCOPE_CYCLE_COUNTER(STAT_RMS_MoveToForce_Parabola_Prepare);
+	PrepareMoveTo(SimulationTime, MovementTickTime, Character, MoveComponent);
 }
 
-bool FRootMotionSource_MoveToDynamicForce_WithRotation::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+UScriptStruct* FRootMotionSource_MoveToForce_Parabola::GetScriptStruct() const
+{
+	return FRootMotionSource_MoveToForce_Parabola::StaticStruct();
+}
+
+FString FRootMotionSource_MoveToForce_Parabola::ToSimpleString() const
 {
+	return FString::Printf(
+		TEXT("[ID:%u]FRootMotionSource_MoveToForce_Parabola %s"), LocalID, *InstanceName.GetPlainNameString());
+}
 
-	if (!FRootMotionSource::NetSerialize(Ar, Map, bOutSuccess))
+bool FRootMotionSource_MoveToForce_Parabola::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	if (!FRootMotionSource_MoveToDynamicForce_WithRotation::NetSerialize(Ar, Map, bOutSuccess))
 	{
 		return false;
 	}
-	Ar << StartRotation;
-	Ar << StartLocation; // TODO-RootMotionSource: Quantization
-	Ar << InitialTargetLocation; // TODO-RootMotionSource: Quantization
-	Ar << TargetLocation; // TODO-RootMotionSource: Quantization
-	Ar << bRestrictSpeedToExpected;
-	Ar << RotationSetting;
-	//Ar << PathOffsetCurve;
-	//Ar << TimeMappingCurve;
-
-	bOutSuccess = true;
-	return true;
-	
-	//return FRootMotionSource_MoveToDynamicForce::NetSerialize(Ar, Map, bOutSuccess);
+	RMSNetQuantize::SerializeAssetCurve(Ar, ParabolaCurve);
+	//与位置相同的0.1精度
+	int32 QuantizedHeight = FMath::RoundToInt(ParabolaHeight * 10.f);
+	RMSNetQuantize::SerializeInt(Ar, QuantizedHeight);
+	if (Ar.IsLoading())
+	{
+		ParabolaHeight = QuantizedHeight / 10.f;
+	}
+	return !Ar.IsError();
 }
 
-FRootMotionSource* FRootMotionSource_MoveToDynamicForce_WithRotation::Clone() const
+FRootMotionSource* FRootMotionSource_MoveToForce_Parabola::Clone() const
 {
-	FRootMotionSource_MoveToDynamicForce_WithRotation* CopyPtr = new FRootMotionSource_MoveToDynamicForce_WithRotation(*this);
+	FRootMotionSource_MoveToForce_Parabola* CopyPtr = new FRootMotionSource_MoveToForce_Parabola(*this);
+	CopyPtr->ClearPendingUpdate();
 	return CopyPtr;
 }
 
-bool FRootMotionSource_MoveToDynamicForce_WithRotation::Matches(const FRootMotionSource* Other) const
+bool FRootMotionSource_MoveToForce_Parabola::Matches(const FRootMotionSource* Other) const
 {
-	if (!FRootMotionSource::Matches(Other))
+	if (!FRootMotionSource_MoveToDynamicForce_WithRotation::Matches(Other))
 	{
 		return false;
 	}
-	const FRootMotionSource_MoveToDynamicForce_WithRotation* OtherCast = static_cast<const FRootMotionSource_MoveToDynamicForce_WithRotation*>(Other);
+	const FRootMotionSource_MoveToForce_Parabola* OtherCast = static_cast<const FRootMotionSource_MoveToForce_Parabola*>(Other);
 
-	return RotationSetting == OtherCast->RotationSetting && StartRotation == OtherCast->StartRotation;
+	//本地应用的运行时曲线不会同步, 服务器发来的是空
+	return RMSNetQuantize::AssetCurveEquals(ParabolaCurve, OtherCast->ParabolaCurve) &&
+		FMath::IsNearlyEqual(ParabolaHeight, OtherCast->ParabolaHeight, RMSNetQuantize::LocationTolerance);
 }
 
-bool FRootMotionSource_MoveToDynamicForce_WithRotation::MatchesAndHasSameState(const FRootMotionSource* Other) const
+void FRootMotionSource_MoveToForce_Parabola::AddReferencedObjects(FReferenceCollector& Collector)
 {
-	if (!FRootMotionSource::MatchesAndHasSameState(Other))
-	{
-		return false;
-	}
-
-	return true;
+	Collector.AddReferencedObject(ParabolaCurve);
+	FRootMotionSource_MoveToDynamicForce_WithRotation::AddReferencedObjects(Collector);
 }
 #pragma endregion FRootMotionSource_PathMoveToForce
 
@@ -914,10 +1464,8 @@ FTransform FRootMotionSource_AnimWarping::ProcessRootMotion(const ACharacter& Ch
 
 	if (!RootMotionDelta.GetTranslation().IsNearlyZero())
 	{
-		const FTransform CurrentTransform = FTransform(
-			Character.GetActorQuat(),
-			Character.GetActorLocation() - FVector(
-				0.f, 0.f, Character.GetCapsuleComponent()->GetScaledCapsuleHalfHeight()));
+		const FRMSCharacterFrameContext& Context = FRMSCharacterFrameContext::Get(Character);
+		const FTransform CurrentTransform = FTransform(Context.ActorQuat, Context.FootLocation);
 		//剩下的总共的RootMotion
 		const FTransform RootMotionTotalWorldSpace = CurrentTransform * Character.GetMesh()->
 			ConvertLocalRootMotionToWorld(RootMotionTotal);
@@ -925,7 +1473,6 @@ FTransform FRootMotionSource_AnimWarping::ProcessRootMotion(const ACharacter& Ch
 		const FTransform RootMotionDeltaWorldSpace = Character.GetMesh()->ConvertLocalRootMotionToWorld(
 			RootMotionDelta);
 		const FVector CurrentLocation = CurrentTransform.GetLocation();
-		const FQuat CurrentRotation = CurrentTransform.GetRotation();
 
 		FVector TargetLocation = GetTargetLocation();
 		if (bIgnoreZAxis)
@@ -942,104 +1489,22 @@ FTransform FRootMotionSource_AnimWarping::ProcessRootMotion(const ACharacter& Ch
 		const FVector CurrentToRootOffset = FutureLocation - CurrentLocation;
 
 
-		// 创建一个矩阵，我们可以用它把所有的东西放在一个空间中，直视RootMotionSyncPosition。“向前”应该是我们想要缩放的轴。
-		//todo 实际上就是找到当前运动做接近的一个轴向作为向前的轴
-		FVector ToRootNormalized = CurrentToRootOffset.GetSafeNormal();
-		float BestMatchDot = FMath::Abs(FVector::DotProduct(ToRootNormalized, CurrentRotation.GetAxisX()));
-		FMatrix ToRootSyncSpace = FRotationMatrix::MakeFromXZ(ToRootNormalized, CurrentRotation.GetAxisZ());
-
-		float ZDot = FMath::Abs(FVector::DotProduct(ToRootNormalized, CurrentRotation.GetAxisZ()));
-		if (ZDot > BestMatchDot)
-		{
-			ToRootSyncSpace = FRotationMatrix::MakeFromXZ(ToRootNormalized, CurrentRotation.GetAxisX());
-			BestMatchDot = ZDot;
-		}
-
-		float YDot = FMath::Abs(FVector::DotProduct(ToRootNormalized, CurrentRotation.GetAxisY()));
-		if (YDot > BestMatchDot)
-		{
-			ToRootSyncSpace = FRotationMatrix::MakeFromXZ(ToRootNormalized, CurrentRotation.GetAxisZ());
-		}
-
-		// 把所有偏移信息都放入这个空间中
-		const FVector RootMotionInSyncSpace = ToRootSyncSpace.InverseTransformVector(Translation);
-		const FVector CurrentToWorldSync = ToRootSyncSpace.InverseTransformVector(CurrentToWorldOffset);
-		const FVector CurrentToRootMotionSync = ToRootSyncSpace.InverseTransformVector(CurrentToRootOffset);
-
-		FVector CurrentToWorldSyncNorm = CurrentToWorldSync;
-		CurrentToWorldSyncNorm.Normalize();
-
-		FVector CurrentToRootMotionSyncNorm = CurrentToRootMotionSync;
-		CurrentToRootMotionSyncNorm.Normalize();
-
-		// 计算偏斜的角度Yaw
-		FVector FlatToWorld = FVector(CurrentToWorldSyncNorm.X, CurrentToWorldSyncNorm.Y, 0.0f);
-		FlatToWorld.Normalize();
-		FVector FlatToRoot = FVector(CurrentToRootMotionSyncNorm.X, CurrentToRootMotionSyncNorm.Y, 0.0f);
-		FlatToRoot.Normalize();
-		float AngleAboutZ = FMath::Acos(FVector::DotProduct(FlatToWorld, FlatToRoot));
-		float AngleAboutZNorm = FMath::DegreesToRadians(
-			FRotator::NormalizeAxis(FMath::RadiansToDegrees(AngleAboutZ)));
-		if (FlatToWorld.Y < 0.0f)
-		{
-			AngleAboutZNorm *= -1.0f;
-		}
-
-		// 计算偏斜的角度Pitch
-		FVector ToWorldNoY = FVector(CurrentToWorldSyncNorm.X, 0.0f, CurrentToWorldSyncNorm.Z);
-		ToWorldNoY.Normalize();
-		FVector ToRootNoY = FVector(CurrentToRootMotionSyncNorm.X, 0.0f, CurrentToRootMotionSyncNorm.Z);
-		ToRootNoY.Normalize();
-		const float AngleAboutY = FMath::Acos(FVector::DotProduct(ToWorldNoY, ToRootNoY));
-		float AngleAboutYNorm = FMath::DegreesToRadians(
-			FRotator::NormalizeAxis(FMath::RadiansToDegrees(AngleAboutY)));
-		if (ToWorldNoY.Z < 0.0f)
-		{
-			AngleAboutYNorm *= -1.0f;
-		}
-
-		FVector SkewedRootMotion = FVector::ZeroVector;
-		float ProjectedScale = FVector::DotProduct(CurrentToWorldSync, CurrentToRootMotionSyncNorm) /
-			CurrentToRootMotionSync.Size();
-		if (ProjectedScale != 0.0f)
-		{
-			FMatrix ScaleMatrix;
-			ScaleMatrix.SetIdentity();
-			ScaleMatrix.SetAxis(0, FVector(ProjectedScale, 0.0f, 0.0f));
-			ScaleMatrix.SetAxis(1, FVector(0.0f, 1.0f, 0.0f));
-			ScaleMatrix.SetAxis(2, FVector(0.0f, 0.0f, 1.0f));
-
-			FMatrix ShearXAlongYMatrix;
-			ShearXAlongYMatrix.SetIdentity();
-			ShearXAlongYMatrix.SetAxis(0, FVector(1.0f, FMath::Tan(AngleAboutZNorm), 0.0f));
-			ShearXAlongYMatrix.SetAxis(1, FVector(0.0f, 1.0f, 0.0f));
-			ShearXAlongYMatrix.SetAxis(2, FVector(0.0f, 0.0f, 1.0f));
-
-			FMatrix ShearXAlongZMatrix;
-			ShearXAlongZMatrix.SetIdentity();
-			ShearXAlongZMatrix.SetAxis(0, FVector(1.0f, 0.0f, FMath::Tan(AngleAboutYNorm)));
-			ShearXAlongZMatrix.SetAxis(1, FVector(0.0f, 1.0f, 0.0f));
-			ShearXAlongZMatrix.SetAxis(2, FVector(0.0f, 0.0f, 1.0f));
-
-			FMatrix ScaledSkewMatrix = ScaleMatrix * ShearXAlongYMatrix * ShearXAlongZMatrix;
-
-			// Skew and scale the Root motion. 
-			SkewedRootMotion = ScaledSkewMatrix.TransformVector(RootMotionInSyncSpace);
-		}
-		else if (!CurrentToRootMotionSync.IsZero() && !CurrentToWorldSync.IsZero() && !RootMotionInSyncSpace.
-			IsZero())
+		// 在动画剩余RootMotion的方向上缩放, 垂直方向上偏斜到目标, 见FRMSWarpKernel
+		const FVector WarpedTranslation = FRMSWarpKernel::WarpTranslation(Translation, CurrentToRootOffset,
+		                                                                  CurrentToWorldOffset);
+#if RMS_DEBUG
+		if (RMS::CVarRMS_ValidateWarpKernel.GetValueOnGameThread() > 0)
 		{
-			// Figure out ratio between remaining Root and remaining World. Then project scaled length of current Root onto World.
-			const float Scale = CurrentToWorldSync.Size() / CurrentToRootMotionSync.Size();
-			const float StepTowardTarget = RootMotionInSyncSpace.ProjectOnTo(RootMotionInSyncSpace).Size();
-			SkewedRootMotion = CurrentToWorldSyncNorm * (Scale * StepTowardTarget);
+			const FVector Reference = FRMSWarpKernel::WarpTranslation_Reference(
+				Translation, CurrentToRootOffset, CurrentToWorldOffset, Context.ActorQuat);
+			if (!Reference.Equals(WarpedTranslation, 0.01f))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("RMS warp kernel mismatch: %s, reference %s"),
+				       *WarpedTranslation.ToString(), *Reference.ToString());
+			}
 		}
-
-		// Put our result back in world space.  
-		FinalRootMotion.SetTranslation(ToRootSyncSpace.TransformVector(SkewedRootMotion));
-
-		
-	
+#endif
+		FinalRootMotion.SetTranslation(WarpedTranslation);
 	}
 	if (RotationSetting.IsWarpRotation())
 	{
@@ -1055,6 +1520,57 @@ FTransform FRootMotionSource_AnimWarping::ProcessRootMotion(const ACharacter& Ch
 	return FinalRootMotion;
 }
 
+FVector FRootMotionSource_AnimWarping::GetWorldRootMotionOffset(USkeletalMeshComponent& Mesh, float StartAnimTime,
+                                                                float EndAnimTime) const
+{
+	//与InitStartSpace相同的起始空间: 模型相对角色的朝向加上StartRotation, 不随角色之后的转向改变
+	const FQuat StartMeshRotation = StartRotation.Quaternion() * Mesh.GetRelativeRotation().Quaternion();
+	const FVector LocalTranslation = ExtractRootMotion(StartAnimTime, EndAnimTime).GetTranslation();
+	return StartMeshRotation.RotateVector(Mesh.GetComponentScale() * LocalTranslation);
+}
+
+FVector FRootMotionSource_AnimWarping::PredictWarpedFootLocation(USkeletalMeshComponent& Mesh,
+                                                                 const FVector& SegmentStart,
+                                                                 const FVector& SegmentTarget,
+                                                                 const FVector& SegmentRootOffset,
+                                                                 float SegmentStartAnimTime, float AnimTime) const
+{
+	FVector Target = SegmentTarget;
+	if (bIgnoreZAxis)
+	{
+		Target.Z = SegmentStart.Z;
+	}
+	const FVector Translation = GetWorldRootMotionOffset(Mesh, SegmentStartAnimTime, AnimTime);
+	return SegmentStart + FRMSWarpKernel::WarpTranslation(Translation, SegmentRootOffset, Target - SegmentStart);
+}
+
+bool FRootMotionSource_AnimWarping::SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+                                                     TArrayView<FVector> OutLocations) const
+{
+	USkeletalMeshComponent* Mesh = Character.GetMesh();
+	if (!Animation || !Mesh || Duration <= SMALL_NUMBER)
+	{
+		return false;
+	}
+	const float CurrEndTime = (AnimEndTime < 0 || AnimEndTime > Animation->GetPlayLength())
+		                          ? Animation->GetPlayLength()
+		                          : AnimEndTime;
+	//与PrepareRootMotion相同的时间缩放
+	const float TimeScale = (CurrEndTime - StartTime) / Duration;
+	const float HalfHeight = FRMSCharacterFrameContext::Get(Character).HalfHeight;
+	const FVector StartFoot = StartLocation - FVector(0.f, 0.f, HalfHeight);
+	const FVector RootOffset = GetWorldRootMotionOffset(*Mesh, 0.f, CurrEndTime);
+	//初始化之前目标就是动画本身的终点
+	const FVector Target = bInit ? GetTargetLocation() : StartFoot + RootOffset;
+	for (int32 i = 0; i < Times.Num(); i++)
+	{
+		const float AnimTime = FMath::Clamp(Times[i], 0.f, Duration) * TimeScale;
+		OutLocations[i] = PredictWarpedFootLocation(*Mesh, StartFoot, Target, RootOffset, 0.f, AnimTime) +
+			FVector(0.f, 0.f, HalfHeight);
+	}
+	return true;
+}
+
 bool FRootMotionSource_AnimWarping::UpdateStateFrom(const FRootMotionSource* SourceToTakeStateFrom,
                                                     bool bMarkForSimulatedCatchup)
 {
@@ -1070,6 +1586,7 @@ void FRootMotionSource_AnimWarping::PrepareRootMotion(float SimulationTime, floa
                                                       const ACharacter& Character,
                                                       const UCharacterMovementComponent& MoveComponent)
 {
+	SCOPE_CYCLE_COUNTER(STAT_RMS_AnimWarping_Prepare);
 	RootMotionParams.Clear();
 
 	if (Animation && Duration
@@ -1082,28 +1599,15 @@ void FRootMotionSource_AnimWarping::PrepareRootMotion(float SimulationTime, floa
 			                          : AnimEndTime;
 		const float CalcDuration = CurrEndTime - StartTime;
 		const float TimeScale = CalcDuration / Duration;
-		const FTransform StartFootTransform = FTransform(StartRotation,
-		                                                 StartLocation - FVector(
-			                                                 0.f, 0.f,
-			                                                 Character.GetCapsuleComponent()->
-			                                                           GetScaledCapsuleHalfHeight()));
-		const FTransform CurrChacterFootTransform = FTransform(StartRotation,
-		                                                       Character.GetActorLocation() - FVector(
-			                                                       0.f, 0.f,
-			                                                       Character.GetCapsuleComponent()->
-			                                                                 GetScaledCapsuleHalfHeight()));
-		FTransform MeshTransformWS = Character.GetMesh()->GetComponentTransform();
-		FTransform Mesh2CharInverse = StartFootTransform.GetRelativeTransform(MeshTransformWS);
-
-		FTransform TargetTransform = ExtractRootMotion(AnimStartTime, CurrEndTime);
-		TargetTransform = TargetTransform * MeshTransformWS; //模型世界空间的RM
-		//通过逆矩阵把模型空间转换成actor空间
-		const FTransform TargetTransformWS = Mesh2CharInverse * TargetTransform;
+		const FRMSCharacterFrameContext& Context = FRMSCharacterFrameContext::Get(Character);
+		const FTransform CurrChacterFootTransform = FTransform(StartRotation, Context.FootLocation);
 
 		if (!bInit)
 		{
 			bInit = true;
-			SetTargetLocation(TargetTransformWS.GetLocation());
+			InitStartSpace(Context);
+			//通过逆矩阵把模型空间转换成actor空间
+			SetTargetLocation(GetRootMotionTargetInStartSpace(Context, AnimStartTime, CurrEndTime).GetLocation());
 		}
 
 
@@ -1114,18 +1618,17 @@ void FRootMotionSource_AnimWarping::PrepareRootMotion(float SimulationTime, floa
 		FTransform WarpTransform = ProcessRootMotion(Character, CurrRootMotion, PrevTime, CurrTime, SimulationTime);
 		//因为是世界空间的,所以是右乘
 		FTransform WarpTransformWS = CurrChacterFootTransform * WarpTransform;
-		const FVector CurrentLocation = Character.GetActorLocation() - FVector(
-			0, 0, Character.GetCapsuleComponent()->GetScaledCapsuleHalfHeight());
+		const FVector CurrentLocation = Context.FootLocation;
 
 		FVector Force = (WarpTransformWS.GetLocation() - CurrentLocation) / MovementTickTime;
 
 		// Debug
-#if ROOT_MOTION_DEBUG
+#if RMS_DEBUG
 		if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 		{
 			const FVector LocDiff = MoveComponent.UpdatedComponent->GetComponentLocation() - CurrentLocation;
 			const float DebugLifetime = 5;
-			UE_LOG(LogTemp, Log, TEXT("Target = %s"), *TargetTransform.ToString());
+			UE_LOG(LogTemp, Log, TEXT("Target = %s"), *GetTargetLocation().ToString());
 			// Current
 			DrawDebugCapsule(Character.GetWorld(), MoveComponent.UpdatedComponent->GetComponentLocation(),
 			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
@@ -1137,7 +1640,7 @@ void FRootMotionSource_AnimWarping::PrepareRootMotion(float SimulationTime, floa
 			                 FQuat::Identity, FColor::Green, false, DebugLifetime);
 
 			// Target
-			DrawDebugCapsule(Character.GetWorld(), TargetTransformWS.GetLocation() + LocDiff,
+			DrawDebugCapsule(Character.GetWorld(), GetTargetLocation() + LocDiff,
 			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
 			                 FQuat::Identity, FColor::Blue, false, DebugLifetime);
 
@@ -1160,16 +1663,11 @@ void FRootMotionSource_AnimWarping::PrepareRootMotion(float SimulationTime, floa
 
 FTransform FRootMotionSource_AnimWarping::ExtractRootMotion(float InStartTime, float InEndTime) const
 {
-	FTransform OutTransform;
-	if (UAnimSequence* Seq = Cast<UAnimSequence>(Animation))
-	{
-		OutTransform = Seq->ExtractRootMotionFromRange(InStartTime, InEndTime);
-	}
-	else if (UAnimMontage* Montage = Cast<UAnimMontage>(Animation))
+	if (!BakedRootMotion.IsValid() && Animation)
 	{
-		OutTransform = Montage->ExtractRootMotionFromTrackRange(InStartTime, InEndTime);
+		BakedRootMotion = FRMSAnimationCache::Get().FindOrBakeRootMotion(Animation);
 	}
-	return OutTransform;
+	return FRMSAnimationCache::ExtractRootMotion(Animation, BakedRootMotion.Get(), InStartTime, InEndTime);
 }
 
 FQuat FRootMotionSource_AnimWarping::WarpRotation(const ACharacter& Character, const FTransform& RootMotionDelta,
@@ -1200,17 +1698,23 @@ bool FRootMotionSource_AnimWarping::NetSerialize(FArchive& Ar, UPackageMap* Map,
 	{
 		return false;
 	}
-	Ar << StartLocation; // TODO-RootMotionSource: Quantization
-	Ar << StartRotation;
-	Ar << AnimStartTime;
-	Ar << AnimEndTime;
-	Ar << Animation;
+	if (!RMSNetQuantize::SerializeVersion(Ar))
+	{
+		bOutSuccess = false;
+		return false;
+	}
+	bOutSuccess = RMSNetQuantize::SerializeLocation(Ar, StartLocation);
+	RMSNetQuantize::SerializeRotator(Ar, StartRotation);
+	//先发送动画, 后面的时间按动画的帧发送
+	RMSNetQuantize::SerializeAnimation(Ar, Animation);
+	const FFrameRate FrameRate = RMSNetQuantize::GetAnimationFrameRate(Animation);
+	RMSNetQuantize::SerializeFrameTime(Ar, AnimStartTime, FrameRate);
+	RMSNetQuantize::SerializeFrameTime(Ar, AnimEndTime, FrameRate);
 	Ar << bIgnoreZAxis;
-	Ar << CachedEndTime;
-	Ar << RotationSetting;
+	RMSNetQuantize::SerializeFrameTime(Ar, CachedEndTime, FrameRate);
+	RMSNetQuantize::SerializeRotationSetting(Ar, RotationSetting);
 
-	bOutSuccess = true;
-	return true;
+	return !Ar.IsError();
 }
 
 FRootMotionSource* FRootMotionSource_AnimWarping::Clone() const
@@ -1227,13 +1731,13 @@ bool FRootMotionSource_AnimWarping::Matches(const FRootMotionSource* Other) cons
 	}
 	const FRootMotionSource_AnimWarping* OtherCast = static_cast<const FRootMotionSource_AnimWarping*>(Other);
 
-	return StartLocation == OtherCast->StartLocation &&
-		StartRotation == OtherCast->StartRotation &&
+	return RMSNetQuantize::LocationEquals(StartLocation, OtherCast->StartLocation) &&
+		RMSNetQuantize::RotatorEquals(StartRotation, OtherCast->StartRotation) &&
 		StartTime == OtherCast->StartTime &&
-		AnimEndTime == OtherCast->AnimEndTime &&
+		RMSNetQuantize::TimeEquals(AnimEndTime, OtherCast->AnimEndTime) &&
 		Animation == OtherCast->Animation &&
 		bIgnoreZAxis == OtherCast->bIgnoreZAxis &&
-		RotationSetting == OtherCast->RotationSetting;
+		RMSNetQuantize::RotationSettingEquals(RotationSetting, OtherCast->RotationSetting);
 }
 
 bool FRootMotionSource_AnimWarping::MatchesAndHasSameState(const FRootMotionSource* Other) const
@@ -1242,8 +1746,19 @@ bool FRootMotionSource_AnimWarping::MatchesAndHasSameState(const FRootMotionSour
 	{
 		return false;
 	}
+	const FRootMotionSource_AnimWarping* OtherCast = static_cast<const FRootMotionSource_AnimWarping*>(Other);
 
-	return true;
+	return GetStateFingerprint() == OtherCast->GetStateFingerprint();
+}
+
+uint64 FRootMotionSource_AnimWarping::GetStateFingerprint() const
+{
+	RMSNetQuantize::FFingerprint Fingerprint;
+	Fingerprint.AddInt(bInit);
+	Fingerprint.AddTime(CachedEndTime);
+	Fingerprint.AddLocation(CachedTarget);
+	Fingerprint.AddRotator(CachedRotation);
+	return Fingerprint.Get();
 }
 
 UScriptStruct* FRootMotionSource_AnimWarping::GetScriptStruct() const
@@ -1273,6 +1788,7 @@ void FRootMotionSource_AnimWarping_FinalPoint::PrepareRootMotion(float Simulatio
                                                                  const ACharacter& Character,
                                                                  const UCharacterMovementComponent& MoveComponent)
 {
+	SCOPE_CYCLE_COUNTER(STAT_RMS_AnimWarping_FinalPoint_Prepare);
 	RootMotionParams.Clear();
 
 	if (Animation && Duration
@@ -1285,27 +1801,13 @@ void FRootMotionSource_AnimWarping_FinalPoint::PrepareRootMotion(float Simulatio
 			                          : AnimEndTime;
 		const float CalcDuration = CurrEndTime - StartTime;
 		const float TimeScale = CalcDuration / Duration;
-		const FTransform StartFootTransform = FTransform(StartRotation,
-		                                                 StartLocation - FVector(
-			                                                 0.f, 0.f,
-			                                                 Character.GetCapsuleComponent()->
-			                                                           GetScaledCapsuleHalfHeight()));
-		const FTransform CurrChacterFootTransform = FTransform(StartRotation,
-		                                                       Character.GetActorLocation() - FVector(
-			                                                       0.f, 0.f,
-			                                                       Character.GetCapsuleComponent()->
-			                                                                 GetScaledCapsuleHalfHeight()));
-		FTransform MeshTransformWS = Character.GetMesh()->GetComponentTransform();
-		FTransform Mesh2CharInverse = StartFootTransform.GetRelativeTransform(MeshTransformWS);
-
-		FTransform TargetTransform = ExtractRootMotion(AnimStartTime, CurrEndTime);
-		TargetTransform = TargetTransform * MeshTransformWS; //模型世界空间的RM
-		//通过逆矩阵把模型空间转换成actor空间
-		const FTransform TargetTransformWS = Mesh2CharInverse * TargetTransform;
+		const FRMSCharacterFrameContext& Context = FRMSCharacterFrameContext::Get(Character);
+		const FTransform CurrChacterFootTransform = FTransform(StartRotation, Context.FootLocation);
 
 		if (!bInit)
 		{
 			bInit = true;
+			InitStartSpace(Context);
 			SetTargetLocation(TargetLocation);
 			SetTargetRotation(TargetRotation);
 		}
@@ -1323,18 +1825,17 @@ void FRootMotionSource_AnimWarping_FinalPoint::PrepareRootMotion(float Simulatio
 		WarpTransform.SetRotation(FQuat::Identity);
 		//因为是世界空间的,所以是右乘
 		FTransform WarpTransformWS = CurrChacterFootTransform * WarpTransform;
-		const FVector CurrentLocation = Character.GetActorLocation() - FVector(
-			0, 0, Character.GetCapsuleComponent()->GetScaledCapsuleHalfHeight());
+		const FVector CurrentLocation = Context.FootLocation;
 
 		FVector Force = (WarpTransformWS.GetLocation() - CurrentLocation) / MovementTickTime;
 
 		// Debug
-#if ROOT_MOTION_DEBUG
+#if RMS_DEBUG
 		if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 		{
 			const FVector LocDiff = MoveComponent.UpdatedComponent->GetComponentLocation() - CurrentLocation;
 			const float DebugLifetime = 5;
-			UE_LOG(LogTemp, Log, TEXT("Target = %s"), *TargetTransform.ToString());
+			UE_LOG(LogTemp, Log, TEXT("Target = %s"), *GetTargetLocation().ToString());
 			// Current
 			DrawDebugCapsule(Character.GetWorld(), MoveComponent.UpdatedComponent->GetComponentLocation(),
 			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
@@ -1346,9 +1847,10 @@ void FRootMotionSource_AnimWarping_FinalPoint::PrepareRootMotion(float Simulatio
 			                 FQuat::Identity, FColor::Green, false, DebugLifetime);
 
 			// Target
-			// DrawDebugCapsule(Character.GetWorld(), TargetTransformWS.GetLocation() + LocDiff,
-			//                  Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
-			//                  FQuat::Identity, FColor::Blue, false, DebugLifetime);
+			DrawDebugCapsule(Character.GetWorld(), GetRootMotionTargetInStartSpace(Context, AnimStartTime, CurrEndTime).
+			                 GetLocation() + LocDiff,
+			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
+			                 FQuat::Identity, FColor::Blue, false, DebugLifetime);
 
 			// Force
 			DrawDebugLine(Character.GetWorld(), CurrentLocation, CurrentLocation + Force, FColor::Blue, false,
@@ -1376,13 +1878,12 @@ void FRootMotionSource_AnimWarping_FinalPoint::PrepareRootMotion(float Simulatio
 bool FRootMotionSource_AnimWarping_FinalPoint::NetSerialize(FArchive& Ar, UPackageMap* Map,
                                                             bool& bOutSuccess)
 {
-	if (!FRootMotionSource::NetSerialize(Ar, Map, bOutSuccess))
+	if (!FRootMotionSource_AnimWarping::NetSerialize(Ar, Map, bOutSuccess))
 	{
 		return false;
 	}
-	Ar << TargetLocation;
-	bOutSuccess = true;
-	return bOutSuccess;
+	bOutSuccess = RMSNetQuantize::SerializeOffset(Ar, TargetLocation, StartLocation);
+	return !Ar.IsError();
 }
 
 FRootMotionSource* FRootMotionSource_AnimWarping_FinalPoint::Clone() const
@@ -1400,10 +1901,35 @@ bool FRootMotionSource_AnimWarping_FinalPoint::Matches(const FRootMotionSource*
 	const FRootMotionSource_AnimWarping_FinalPoint* OtherCast = static_cast<const
 		FRootMotionSource_AnimWarping_FinalPoint*>(Other);
 
-	return TargetLocation == OtherCast->TargetLocation;;
+	return RMSNetQuantize::LocationEquals(TargetLocation, OtherCast->TargetLocation);
 }
 
 
+bool FRootMotionSource_AnimWarping_FinalPoint::SampleTrajectory(const ACharacter& Character,
+                                                                TConstArrayView<float> Times,
+                                                                TArrayView<FVector> OutLocations) const
+{
+	USkeletalMeshComponent* Mesh = Character.GetMesh();
+	if (!Animation || !Mesh || Duration <= SMALL_NUMBER)
+	{
+		return false;
+	}
+	const float CurrEndTime = (AnimEndTime < 0 || AnimEndTime > Animation->GetPlayLength())
+		                          ? Animation->GetPlayLength()
+		                          : AnimEndTime;
+	const float TimeScale = (CurrEndTime - StartTime) / Duration;
+	const float HalfHeight = FRMSCharacterFrameContext::Get(Character).HalfHeight;
+	const FVector StartFoot = StartLocation - FVector(0.f, 0.f, HalfHeight);
+	const FVector RootOffset = GetWorldRootMotionOffset(*Mesh, 0.f, CurrEndTime);
+	for (int32 i = 0; i < Times.Num(); i++)
+	{
+		const float AnimTime = FMath::Clamp(Times[i], 0.f, Duration) * TimeScale;
+		OutLocations[i] = PredictWarpedFootLocation(*Mesh, StartFoot, TargetLocation, RootOffset, 0.f, AnimTime) +
+			FVector(0.f, 0.f, HalfHeight);
+	}
+	return true;
+}
+
 UScriptStruct* FRootMotionSource_AnimWarping_FinalPoint::GetScriptStruct() const
 {
 	return FRootMotionSource_AnimWarping_FinalPoint::StaticStruct();
@@ -1420,39 +1946,60 @@ FString FRootMotionSource_AnimWarping_FinalPoint::ToSimpleString() const
 //***************************FRootMotionSource_AnimWarping_MultiTargets********************************
 #pragma region FRootMotionSource_AnimWarping_MultiTargets
 
+void FRootMotionSource_AnimWarping_MultiTargets::SetTriggerDatas(TArray<FRMSTarget> InTriggerDatas)
+{
+	TriggerDatas = MakeShared<TArray<FRMSTarget>, ESPMode::ThreadSafe>(MoveTemp(InTriggerDatas));
+	TriggerDatasFingerprint = RMSNetQuantize::HashTargets(*TriggerDatas);
+	TriggerIndex = INDEX_NONE;
+}
+
+const TArray<FRMSTarget>& FRootMotionSource_AnimWarping_MultiTargets::GetTriggerDatas() const
+{
+	static const TArray<FRMSTarget> EmptyTriggerDatas;
+	return TriggerDatas.IsValid() ? *TriggerDatas : EmptyTriggerDatas;
+}
+
 bool FRootMotionSource_AnimWarping_MultiTargets::UpdateTriggerTarget(float SimulationTime, float TimeScale)
 {
+	const TArray<FRMSTarget>& Targets = GetTriggerDatas();
+	if (!Targets.IsValidIndex(TriggerIndex))
+	{
+		return false;
+	}
 	const float CurrTime = (GetTime() + SimulationTime) * TimeScale;
-	const int32 idx = TriggerDatas.Find(CurrTriggerData);
-	if (idx >= 0 && idx < TriggerDatas.Num() - 1 && CurrTime > CurrTriggerData.EndTime)
+	const int32 LastIndex = TriggerIndex;
+	while (TriggerIndex < Targets.Num() - 1 && CurrTime > Targets[TriggerIndex].EndTime)
 	{
-		LastTriggerData = CurrTriggerData;
-		CurrTriggerData = TriggerDatas[idx + 1 ];
-		RotationSetting = CurrTriggerData.RotationSetting;
-		return true;
+		TriggerIndex++;
 	}
-
-	return false;
+	if (TriggerIndex == LastIndex)
+	{
+		return false;
+	}
+	RotationSetting = GetCurrTriggerData().RotationSetting;
+	return true;
 }
 
 void FRootMotionSource_AnimWarping_MultiTargets::PrepareRootMotion(float SimulationTime, float MovementTickTime,
                                                                    const ACharacter& Character,
                                                                    const UCharacterMovementComponent& MoveComponent)
 {
+	SCOPE_CYCLE_COUNTER(STAT_RMS_AnimWarping_MultiTargets_Prepare);
 	RootMotionParams.Clear();
 
-	if (TriggerDatas.Num() > 0 && Animation && Duration > SMALL_NUMBER && MovementTickTime > SMALL_NUMBER)
+	const TArray<FRMSTarget>& Targets = GetTriggerDatas();
+	if (Targets.Num() > 0 && Animation && Duration > SMALL_NUMBER && MovementTickTime > SMALL_NUMBER)
 	{
 		AnimEndTime = Animation->GetPlayLength();
 		const float TimeScale = AnimEndTime / Duration;
-		float RMStartTime = 0;
-		float RMEndTime = 0;
-		if (!bInit)
+		const FRMSCharacterFrameContext& Context = FRMSCharacterFrameContext::Get(Character);
+		if (!bInit || !Targets.IsValidIndex(TriggerIndex))
 		{
 			bInit = true;
-			CurrTriggerData = TriggerDatas[0];
-			RotationSetting = CurrTriggerData.RotationSetting;
-			SetTargetLocation(CurrTriggerData.Target);
+			InitStartSpace(Context);
+			TriggerIndex = 0;
+			RotationSetting = GetCurrTriggerData().RotationSetting;
+			SetTargetLocation(GetCurrTriggerData().Target);
 
 			if (RotationSetting.IsWarpRotation())
 			{
@@ -1471,13 +2018,12 @@ void FRootMotionSource_AnimWarping_MultiTargets::PrepareRootMotion(float Simulat
 			}
 			
 	
-			SetCurrentAnimEndTime(CurrTriggerData.EndTime);
-			RMEndTime = CurrTriggerData.EndTime;
+			SetCurrentAnimEndTime(GetCurrTriggerData().EndTime);
 		}
 		else if (UpdateTriggerTarget(SimulationTime, TimeScale))
 		{
-			SetCurrentAnimEndTime(CurrTriggerData.EndTime);
-			SetTargetLocation(CurrTriggerData.Target);
+			SetCurrentAnimEndTime(GetCurrTriggerData().EndTime);
+			SetTargetLocation(GetCurrTriggerData().Target);
 
 			if (RotationSetting.IsWarpRotation())
 			{
@@ -1487,32 +2033,14 @@ void FRootMotionSource_AnimWarping_MultiTargets::PrepareRootMotion(float Simulat
 				}
 				else
 				{
-					SetTargetRotation((GetTargetLocation() - LastTriggerData.Target).Rotation());
+					const FRMSTarget* LastTriggerData = GetLastTriggerData();
+					SetTargetRotation((GetTargetLocation() - (LastTriggerData ? LastTriggerData->Target : StartLocation)).Rotation());
 				}
 			}
-			
-			RMStartTime = CurrTriggerData.StartTime;
-			RMEndTime = CurrTriggerData.EndTime;
 		}
 
 
-		const FTransform StartFootTransform = FTransform(StartRotation,
-		                                                 StartLocation - FVector(
-			                                                 0.f, 0.f,
-			                                                 Character.GetCapsuleComponent()->
-			                                                           GetScaledCapsuleHalfHeight()));
-		const FTransform CurrChacterFootTransform = FTransform(StartRotation,
-		                                                       Character.GetActorLocation() - FVector(
-			                                                       0.f, 0.f,
-			                                                       Character.GetCapsuleComponent()->
-			                                                                 GetScaledCapsuleHalfHeight()));
-		FTransform MeshTransformWS = Character.GetMesh()->GetComponentTransform();
-		FTransform Mesh2CharInverse = StartFootTransform.GetRelativeTransform(MeshTransformWS);
-		FTransform RootMotionTargetTransform = ExtractRootMotion(RMStartTime, RMEndTime);
-		RootMotionTargetTransform = RootMotionTargetTransform * MeshTransformWS; //模型世界空间的RM
-		//通过逆矩阵把模型空间转换成actor空间
-		const FTransform RootMotionTargetTransformWS = Mesh2CharInverse * RootMotionTargetTransform;
-
+		const FTransform CurrChacterFootTransform = FTransform(StartRotation, Context.FootLocation);
 
 		const float PrevTime = GetTime() * TimeScale;
 		const float CurrTime = (GetTime() + SimulationTime) * TimeScale;
@@ -1527,19 +2055,19 @@ void FRootMotionSource_AnimWarping_MultiTargets::PrepareRootMotion(float Simulat
 		
 		//因为是世界空间的,所以是右乘
 		FTransform WarpTransformWS = CurrChacterFootTransform * WarpTransform;
-		const FVector CurrentLocation = Character.GetActorLocation() - FVector(
-			0, 0, Character.GetCapsuleComponent()->GetScaledCapsuleHalfHeight());
+		const FVector CurrentLocation = Context.FootLocation;
 
 		FVector Force = (WarpTransformWS.GetLocation() - CurrentLocation) / MovementTickTime;
 
 		// Debug
-#if ROOT_MOTION_DEBUG
+#if RMS_DEBUG
 		if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 		{
 			const FVector LocDiff = MoveComponent.UpdatedComponent->GetComponentLocation() - CurrentLocation;
 			const float DebugLifetime = 5;
-			const FVector LastPos = TriggerDatas[TriggerDatas.Num() - 1].Target;
-			UE_LOG(LogTemp, Log, TEXT("Target = %s"), *RootMotionTargetTransform.ToString());
+			const FVector LastPos = Targets.Last().Target;
+			UE_LOG(LogTemp, Log, TEXT("Target = %s"),
+			       *GetRootMotionTargetInStartSpace(Context, GetCurrTriggerData().StartTime, GetCurrTriggerData().EndTime).ToString());
 			// Current
 			DrawDebugCapsule(Character.GetWorld(), MoveComponent.UpdatedComponent->GetComponentLocation(),
 			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
@@ -1559,7 +2087,7 @@ void FRootMotionSource_AnimWarping_MultiTargets::PrepareRootMotion(float Simulat
 			DrawDebugLine(Character.GetWorld(), CurrentLocation, CurrentLocation + Force, FColor::Blue, false,
 			              DebugLifetime);
 
-			DrawDebugCapsule(Character.GetWorld(), CurrTriggerData.Target + LocDiff,
+			DrawDebugCapsule(Character.GetWorld(), GetCurrTriggerData().Target + LocDiff,
 			                 Character.GetSimpleCollisionHalfHeight(), Character.GetSimpleCollisionRadius(),
 			                 FQuat::Identity, FColor::Purple, false, DebugLifetime);
 		}
@@ -1578,13 +2106,26 @@ void FRootMotionSource_AnimWarping_MultiTargets::PrepareRootMotion(float Simulat
 
 bool FRootMotionSource_AnimWarping_MultiTargets::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
 {
-	if (!FRootMotionSource::NetSerialize(Ar, Map, bOutSuccess))
+	if (!FRootMotionSource_AnimWarping::NetSerialize(Ar, Map, bOutSuccess))
 	{
 		return false;
 	}
-	Ar << TriggerDatas;
-	bOutSuccess = true;
-	return bOutSuccess;
+	const FFrameRate FrameRate = RMSNetQuantize::GetAnimationFrameRate(Animation);
+	if (Ar.IsLoading())
+	{
+		TArray<FRMSTarget> NewTriggerDatas;
+		bOutSuccess = RMSNetQuantize::SerializeTargets(Ar, NewTriggerDatas, StartLocation, FrameRate);
+		if (!TriggerDatas.IsValid() || RMSNetQuantize::HashTargets(NewTriggerDatas) != TriggerDatasFingerprint)
+		{
+			SetTriggerDatas(MoveTemp(NewTriggerDatas));
+		}
+	}
+	else
+	{
+		bOutSuccess = RMSNetQuantize::SerializeTargets(Ar, const_cast<TArray<FRMSTarget>&>(GetTriggerDatas()),
+		                                               StartLocation, FrameRate);
+	}
+	return !Ar.IsError();
 }
 
 FRootMotionSource* FRootMotionSource_AnimWarping_MultiTargets::Clone() const
@@ -1602,7 +2143,63 @@ bool FRootMotionSource_AnimWarping_MultiTargets::Matches(const FRootMotionSource
 	const FRootMotionSource_AnimWarping_MultiTargets* OtherCast = static_cast<const
 		FRootMotionSource_AnimWarping_MultiTargets*>(Other);
 
-	return TriggerDatas == OtherCast->TriggerDatas;;
+	if (TriggerDatas == OtherCast->TriggerDatas || TriggerDatasFingerprint == OtherCast->TriggerDatasFingerprint)
+	{
+		return true;
+	}
+	//指纹不同时可能只是正好落在量化边界上, 按误差再比较一次
+	return RMSNetQuantize::TargetsEquals(GetTriggerDatas(), OtherCast->GetTriggerDatas());
+}
+
+bool FRootMotionSource_AnimWarping_MultiTargets::SampleTrajectory(const ACharacter& Character,
+                                                                  TConstArrayView<float> Times,
+                                                                  TArrayView<FVector> OutLocations) const
+{
+	USkeletalMeshComponent* Mesh = Character.GetMesh();
+	const TArray<FRMSTarget>& Targets = GetTriggerDatas();
+	if (!Animation || !Mesh || Duration <= SMALL_NUMBER || Targets.Num() == 0)
+	{
+		return false;
+	}
+	const float TimeScale = Animation->GetPlayLength() / Duration;
+	const float HalfHeight = FRMSCharacterFrameContext::Get(Character).HalfHeight;
+	const FVector StartFoot = StartLocation - FVector(0.f, 0.f, HalfHeight);
+	for (int32 i = 0; i < Times.Num(); i++)
+	{
+		const float AnimTime = FMath::Clamp(Times[i], 0.f, Duration) * TimeScale;
+		//每个窗口从上一个目标出发扭曲到自己的目标, 最后一个窗口之后按原始RootMotion移动
+		FVector SegmentStart = StartFoot;
+		float SegmentStartAnimTime = 0.f;
+		const FRMSTarget* SegmentTarget = nullptr;
+		for (const FRMSTarget& Target : Targets)
+		{
+			if (AnimTime <= Target.EndTime)
+			{
+				SegmentTarget = &Target;
+				break;
+			}
+			SegmentStart = Target.Target;
+			SegmentStartAnimTime = Target.EndTime;
+		}
+		const FVector FootLocation = SegmentTarget
+			                             ? PredictWarpedFootLocation(*Mesh, SegmentStart, SegmentTarget->Target,
+			                                                         GetWorldRootMotionOffset(
+				                                                         *Mesh, SegmentStartAnimTime,
+				                                                         SegmentTarget->EndTime),
+			                                                         SegmentStartAnimTime, AnimTime)
+			                             : SegmentStart + GetWorldRootMotionOffset(
+				                             *Mesh, SegmentStartAnimTime, AnimTime);
+		OutLocations[i] = FootLocation + FVector(0.f, 0.f, HalfHeight);
+	}
+	return true;
+}
+
+uint64 FRootMotionSource_AnimWarping_MultiTargets::GetStateFingerprint() const
+{
+	RMSNetQuantize::FFingerprint Fingerprint;
+	Fingerprint.AddInt(static_cast<int64>(FRootMotionSource_AnimWarping::GetStateFingerprint()));
+	Fingerprint.AddInt(TriggerIndex);
+	return Fingerprint.Get();
 }
 
 UScriptStruct* FRootMotionSource_AnimWarping_MultiTargets::GetScriptStruct() const
@@ -1615,5 +2212,172 @@ FString FRootMotionSource_AnimWarping_MultiTargets::ToSimpleString() const
 	return FString::Printf(
 		TEXT("[ID:%u]FRootMotionSource_AnimWarping_MultiTargets %s"), LocalID, *InstanceName.GetPlainNameString());
 }
+
+void FRootMotionSource_AnimWarping_MultiTargets::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	//GC只会把已经销毁的曲线置空, 对所有共享者都成立
+	for (FRMSTarget& Target : const_cast<TArray<FRMSTarget>&>(GetTriggerDatas()))
+	{
+		Collector.AddReferencedObject(Target.RotationSetting.Curve);
+	}
+	FRootMotionSource_AnimWarping::AddReferencedObjects(Collector);
+}
 #pragma endregion FRootMotionSource_AnimWarping_MultiTargets
-UE_ENABLE_OPTIMIZATION
+
+#if RMS_DEBUG
+namespace
+{
+//从头到尾反复调用PrepareRootMotion, 跑完一遍后回到开始时间, 返回每次调用的平均微秒数
+double BenchmarkPrepareRootMotion(FRootMotionSource& Source, const ACharacter& Character,
+                                  const UCharacterMovementComponent& MoveComponent, int32 Num)
+{
+	const float DeltaTime = 1.f / 60.f;
+	const float StartTime = Source.GetTime();
+	const double Start = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Num; i++)
+	{
+		if (Source.GetTime() + DeltaTime > Source.GetDuration())
+		{
+			Source.SetTime(StartTime);
+		}
+		Source.PrepareRootMotion(DeltaTime, DeltaTime, Character, MoveComponent);
+	}
+	return (FPlatformTime::Seconds() - Start) * 1000000.0 / Num;
+}
+
+//在临时角色上对每种RMS计时, 用来对比优化编译与UE_DISABLE_OPTIMIZATION编译
+void BenchmarkPrepare(const TArray<FString>& Args, UWorld* World)
+{
+	if (!World)
+	{
+		return;
+	}
+	const int32 Num = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+	UAnimSequenceBase* Animation = Args.Num() > 1 ? LoadObject<UAnimSequenceBase>(nullptr, *Args[1]) : nullptr;
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParameters.ObjectFlags |= RF_Transient;
+	ACharacter* Character = World->SpawnActor<ACharacter>(ACharacter::StaticClass(), FTransform::Identity,
+	                                                      SpawnParameters);
+	if (!Character || !Character->GetCharacterMovement())
+	{
+		return;
+	}
+	UCharacterMovementComponent& MoveComponent = *Character->GetCharacterMovement();
+	MoveComponent.SetComponentTickEnabled(false);
+	const FVector Start = Character->GetActorLocation();
+	const FVector Target = Start + FVector(800.f, 300.f, 0.f);
+	FRMSRotationSetting RotationSetting;
+	RotationSetting.Mode = ERMSRotationMode::FaceToTarget;
+
+	auto Report = [](const TCHAR* Name, double Microseconds)
+	{
+		UE_LOG(LogTemp, Log, TEXT("RMS Prepare %s: %.3f us"), Name, Microseconds);
+	};
+
+	{
+		TArray<FRMSPathMoveToData> Path;
+		for (int32 i = 1; i <= 4; i++)
+		{
+			FRMSPathMoveToData& Data = Path.AddDefaulted_GetRef();
+			Data.Duration = 0.5f;
+			Data.Target = FMath::Lerp(Start, Target, i / 4.f) + FVector(0.f, (i & 1) * 100.f, 0.f);
+			Data.RotationSetting = RotationSetting;
+		}
+		FRootMotionSource_PathMoveToForce Source;
+		Source.StartLocation = Start;
+		Source.Duration = 2.f;
+		Source.SetPath(MoveTemp(Path));
+		Report(TEXT("PathMoveToForce"), BenchmarkPrepareRootMotion(Source, *Character, MoveComponent, Num));
+	}
+	{
+		FRootMotionSource_JumpForce_WithPoints Source;
+		Source.Duration = 1.f;
+		Source.StartLocation = Start;
+		Source.HalfWayLocation = (Start + Target) * 0.5f + FVector(0.f, 0.f, 200.f);
+		Source.TargetLocation = Target;
+		Source.RotationSetting = RotationSetting;
+		Source.InitPath();
+		Report(TEXT("JumpForce_WithPoints"), BenchmarkPrepareRootMotion(Source, *Character, MoveComponent, Num));
+	}
+	{
+		FRootMotionSource_MoveToForce_WithRotation Source;
+		Source.Duration = 1.f;
+		Source.StartLocation = Start;
+		Source.TargetLocation = Target;
+		Source.RotationSetting = RotationSetting;
+		Source.BuildCurveLUTs();
+		Report(TEXT("MoveToForce_WithRotation"), BenchmarkPrepareRootMotion(Source, *Character, MoveComponent, Num));
+	}
+	{
+		FRootMotionSource_MoveToDynamicForce_WithRotation Source;
+		Source.Duration = 1.f;
+		Source.StartLocation = Start;
+		Source.InitialTargetLocation = Target;
+		Source.TargetLocation = Target;
+		Source.RotationSetting = RotationSetting;
+		Source.BuildCurveLUTs();
+		Report(TEXT("MoveToDynamicForce_WithRotation"),
+		       BenchmarkPrepareRootMotion(Source, *Character, MoveComponent, Num));
+	}
+	{
+		FRootMotionSource_MoveToForce_Parabola Source;
+		Source.Duration = 1.f;
+		Source.StartLocation = Start;
+		Source.InitialTargetLocation = Target;
+		Source.TargetLocation = Target;
+		Source.ParabolaHeight = 200.f;
+		Source.RotationSetting = RotationSetting;
+		Source.CurveLUTs.Build(nullptr, nullptr, RotationSetting.Curve);
+		Report(TEXT("MoveToForce_Parabola"), BenchmarkPrepareRootMotion(Source, *Character, MoveComponent, Num));
+	}
+	if (Animation && Animation->GetPlayLength() > SMALL_NUMBER)
+	{
+		const float PlayLength = Animation->GetPlayLength();
+		{
+			FRootMotionSource_AnimWarping Source;
+			Source.Animation = Animation;
+			Source.StartLocation = Start;
+			Source.Duration = PlayLength;
+			Report(TEXT("AnimWarping"), BenchmarkPrepareRootMotion(Source, *Character, MoveComponent, Num));
+		}
+		{
+			FRootMotionSource_AnimWarping_FinalPoint Source;
+			Source.Animation = Animation;
+			Source.StartLocation = Start;
+			Source.TargetLocation = Target;
+			Source.Duration = PlayLength;
+			Report(TEXT("AnimWarping_FinalPoint"), BenchmarkPrepareRootMotion(Source, *Character, MoveComponent, Num));
+		}
+		{
+			TArray<FRMSTarget> Targets;
+			for (int32 i = 0; i < 2; i++)
+			{
+				FRMSTarget& Data = Targets.AddDefaulted_GetRef();
+				Data.StartTime = PlayLength * i / 2.f;
+				Data.EndTime = PlayLength * (i + 1) / 2.f;
+				Data.Target = FMath::Lerp(Start, Target, (i + 1) / 2.f);
+			}
+			FRootMotionSource_AnimWarping_MultiTargets Source;
+			Source.Animation = Animation;
+			Source.StartLocation = Start;
+			Source.AnimEndTime = PlayLength;
+			Source.Duration = PlayLength;
+			Source.SetTriggerDatas(MoveTemp(Targets));
+			Report(TEXT("AnimWarping_MultiTargets"),
+			       BenchmarkPrepareRootMotion(Source, *Character, MoveComponent, Num));
+		}
+	}
+	else
+	{
+		UE_LOG(LogTemp, Log, TEXT("RMS Prepare: no animation given, AnimWarping sources skipped"));
+	}
+	Character->Destroy();
+}
+
+FAutoConsoleCommand BenchmarkPrepareCommand(TEXT("RMS.BenchmarkPrepare"),
+                                            TEXT("RMS.BenchmarkPrepare [Num] [AnimationPath]: time PrepareRootMotion of every RMS type on a temporary character"),
+                                            FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkPrepare));
+}
+#endif
@@ -7,6 +7,10 @@
 #include "AnimNotifyState_RMS.h"
 #include "Experimental/RMSComponent.h"
 #include "RMSGroupEx.h"
+#include "RMSAnimationAssetUserData.h"
+#include "RMSAnimationCache.h"
+#include "RMSNetQuantize.h"
+#include "Algo/BinarySearch.h"
 #include "Components/CapsuleComponent.h"
 #include "Curves/CurveVector.h"
 #include "GameFramework/Character.h"
@@ -16,7 +20,31 @@
 
 class UAnimNotifyState_RMS_Warping;
 
-UE_DISABLE_OPTIMIZATION
+namespace
+{
+//PathMoveToForce_V2每两个路点之间的采样数
+constexpr int32 PathCurveSamplesPerWaypoint = 16;
+
+/**
+ * 让服务器模拟的路径偏移与同步出去的数据相同
+ * 生成的路径按 b.RMS.PathCurveMaxSamples / b.RMS.PathCurveTolerance 精简
+ * 联网时客户端找不到的运行时曲线先按 b.RMS.NetCurveSamples 采样, 不再引用曲线
+ */
+void PrepareReplicatedPathOffset(const UCharacterMovementComponent& MovementComponent,
+                                 TObjectPtr<UCurveVector>& Curve, FRMSPathCurve& PathOffset)
+{
+	if (PathOffset.IsValid())
+	{
+		PathOffset = PathOffset.Simplify(RMS::CVarRMS_PathCurveMaxSamples.GetValueOnGameThread(),
+		                                 RMS::CVarRMS_PathCurveTolerance.GetValueOnGameThread());
+	}
+	else if (Curve && !RMSNetQuantize::IsNetAddressable(Curve) && MovementComponent.GetNetMode() != NM_Standalone)
+	{
+		PathOffset = FRMSPathCurve::Sample(*Curve, RMS::CVarRMS_NetCurveSamples.GetValueOnGameThread());
+		Curve = nullptr;
+	}
+}
+}
 
 float URMSLibrary::EvaluateFloatCurveAtFraction(const UCurveFloat& Curve, const float Fraction)
 {
@@ -47,6 +75,23 @@ int32 URMSLibrary::ApplyRootMotionSource_MoveToForce(UCharacterMovementComponent
                                                      float StartTime,
                                                      ERMSApplyMode ApplyMode,
                                                      FRMSSetting_Move Setting)
+{
+	return ApplyRootMotionSource_MoveToForce_Path(MovementComponent, InstanceName, StartLocation, TargetLocation,
+	                                              Duration, Priority, FRMSPathCurve(), RotationSetting, StartTime,
+	                                              ApplyMode, Setting, PathOffsetCurve);
+}
+
+int32 URMSLibrary::ApplyRootMotionSource_MoveToForce_Path(UCharacterMovementComponent* MovementComponent,
+                                                          FName InstanceName,
+                                                          FVector StartLocation, FVector TargetLocation,
+                                                          float Duration,
+                                                          int32 Priority,
+                                                          const FRMSPathCurve& PathOffset,
+                                                          FRMSRotationSetting RotationSetting,
+                                                          float StartTime,
+                                                          ERMSApplyMode ApplyMode,
+                                                          FRMSSetting_Move Setting,
+                                                          UCurveVector* PathOffsetCurve)
 {
 	if (!MovementComponent)
 	{
@@ -58,8 +103,7 @@ int32 URMSLibrary::ApplyRootMotionSource_MoveToForce(UCharacterMovementComponent
 		return -1;
 	}
 
-	TSharedPtr<FRootMotionSource_MoveToForce_WithRotation> MoveToForce = MakeShared<
-		FRootMotionSource_MoveToForce_WithRotation>();
+	TSharedPtr<FRootMotionSource_MoveToForce_WithRotation> MoveToForce(new FRootMotionSource_MoveToForce_WithRotation());
 	MoveToForce->InstanceName = InstanceName == NAME_None ? TEXT("MoveToForce") : InstanceName;
 	MoveToForce->AccumulateMode = Setting.AccumulateMod;
 	MoveToForce->Settings.SetFlag(
@@ -70,6 +114,8 @@ int32 URMSLibrary::ApplyRootMotionSource_MoveToForce(UCharacterMovementComponent
 	MoveToForce->Duration = Duration;
 	MoveToForce->bRestrictSpeedToExpected = Setting.bRestrictSpeedToExpected;
 	MoveToForce->PathOffsetCurve = PathOffsetCurve;
+	MoveToForce->PathOffset = PathOffset;
+	PrepareReplicatedPathOffset(*MovementComponent, MoveToForce->PathOffsetCurve, MoveToForce->PathOffset);
 	MoveToForce->FinishVelocityParams.Mode = static_cast<ERootMotionFinishVelocityMode>(static_cast<uint8>(Setting.
 		VelocityOnFinishMode));
 	MoveToForce->FinishVelocityParams.SetVelocity = Setting.FinishSetVelocity;
@@ -78,6 +124,7 @@ int32 URMSLibrary::ApplyRootMotionSource_MoveToForce(UCharacterMovementComponent
 	MoveToForce->StartRotation = MovementComponent->GetOwner()->GetActorRotation();
 	MoveToForce->RotationSetting = RotationSetting;
 
+	MoveToForce->BuildCurveLUTs();
 	return MovementComponent->ApplyRootMotionSource(MoveToForce);
 }
 
@@ -131,7 +178,7 @@ int32 URMSLibrary::ApplyRootMotionSource_JumpForce_WithPoints(UCharacterMovement
 	{
 		return -1;
 	}
-	TSharedPtr<FRootMotionSource_JumpForce_WithPoints> JumpForce = MakeShared<FRootMotionSource_JumpForce_WithPoints>();
+	TSharedPtr<FRootMotionSource_JumpForce_WithPoints> JumpForce(new FRootMotionSource_JumpForce_WithPoints());
 	JumpForce->InstanceName = InstanceName == NAME_None ? TEXT("Jump") : InstanceName;
 	JumpForce->AccumulateMode = Setting.AccumulateMod;
 	JumpForce->Priority = NewPriority;
@@ -148,6 +195,7 @@ int32 URMSLibrary::ApplyRootMotionSource_JumpForce_WithPoints(UCharacterMovement
 	JumpForce->FinishVelocityParams.SetVelocity = Setting.FinishSetVelocity;
 	JumpForce->FinishVelocityParams.ClampVelocity = Setting.FinishClampVelocity;
 	JumpForce->SetTime(StartTime);
+	JumpForce->InitPath();
 	return MovementComponent->ApplyRootMotionSource(JumpForce);
 	
 }
@@ -172,8 +220,7 @@ int32 URMSLibrary::ApplyRootMotionSource_DynamicMoveToForce(UCharacterMovementCo
 	{
 		return -1;
 	}
-	TSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation> MoveToActorForce = MakeShared<
-		FRootMotionSource_MoveToDynamicForce_WithRotation>();
+	TSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation> MoveToActorForce(new FRootMotionSource_MoveToDynamicForce_WithRotation());
 	MoveToActorForce->InstanceName = InstanceName == NAME_None ? TEXT("DynamicMoveTo") : InstanceName;
 	MoveToActorForce->AccumulateMode = Setting.AccumulateMod;
 	MoveToActorForce->Settings.SetFlag(
@@ -185,6 +232,7 @@ int32 URMSLibrary::ApplyRootMotionSource_DynamicMoveToForce(UCharacterMovementCo
 	MoveToActorForce->Duration = FMath::Max(Duration, KINDA_SMALL_NUMBER);
 	MoveToActorForce->bRestrictSpeedToExpected = Setting.bRestrictSpeedToExpected;
 	MoveToActorForce->PathOffsetCurve = PathOffsetCurve;
+	PrepareReplicatedPathOffset(*MovementComponent, MoveToActorForce->PathOffsetCurve, MoveToActorForce->PathOffset);
 	MoveToActorForce->TimeMappingCurve = TimeMappingCurve;
 	MoveToActorForce->FinishVelocityParams.Mode = static_cast<ERootMotionFinishVelocityMode>(static_cast<uint8>(Setting.
 		VelocityOnFinishMode));
@@ -193,6 +241,7 @@ int32 URMSLibrary::ApplyRootMotionSource_DynamicMoveToForce(UCharacterMovementCo
 	MoveToActorForce->SetTime(StartTime);
 	MoveToActorForce->RotationSetting = RotationSetting;
 	MoveToActorForce->StartRotation = MovementComponent->GetOwner()->GetActorRotation();
+	MoveToActorForce->BuildCurveLUTs();
 	return MovementComponent->ApplyRootMotionSource(MoveToActorForce);
 }
 
@@ -208,7 +257,8 @@ int32 URMSLibrary::ApplyRootMotionSource_MoveToForce_Parabola(
 	int32 Segment,
 	float StartTime,
 	ERMSApplyMode ApplyMode,
-	FRMSSetting_Move Setting)
+	FRMSSetting_Move Setting,
+	float ParabolaHeight)
 {
 	if (!MovementComponent || Duration <= 0)
 	{
@@ -219,8 +269,7 @@ int32 URMSLibrary::ApplyRootMotionSource_MoveToForce_Parabola(
 	{
 		return -1;
 	}
-	TSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation> MoveToForce = MakeShared<
-		FRootMotionSource_MoveToDynamicForce_WithRotation>();
+	TSharedPtr<FRootMotionSource_MoveToForce_Parabola> MoveToForce(new FRootMotionSource_MoveToForce_Parabola());
 	MoveToForce->InstanceName = InstanceName == NAME_None ? TEXT("ParabolaMoveTo") : InstanceName;
 	MoveToForce->AccumulateMode = Setting.AccumulateMod;
 	MoveToForce->Settings.SetFlag(
@@ -230,51 +279,18 @@ int32 URMSLibrary::ApplyRootMotionSource_MoveToForce_Parabola(
 	MoveToForce->Duration = Duration;
 	MoveToForce->StartRotation = MovementComponent->GetOwner()->GetActorRotation();
 	MoveToForce->bRestrictSpeedToExpected = Setting.bRestrictSpeedToExpected;
-	FVector Target = TargetLocation;
-	UCurveVector* PathCurve = NewObject<UCurveVector>();
-	const bool bUseTotalOffset = false;
-	if (ParabolaCurve)
-	{
-		FRichCurve ZCurve;
-		if (bUseTotalOffset)
-		{
-			const float OffsetZ = (TargetLocation - StartLocation).Z;
-			Target.Z = StartLocation.Z;
-			
-			for (int32 i = 0; i <= Segment; i++)
-			{
-				const float Fraction = static_cast<float>(i) / static_cast<float>(Segment);
-				const float FractionZ = FMath::Lerp<float, float>(0, OffsetZ, Fraction);
-				const float Value = ParabolaCurve->GetFloatValue(Fraction);
-				ZCurve.AddKey(Fraction, OffsetZ * Value);
-			}
-		}
-		else
-		{
-			const float OffsetZ = (TargetLocation - StartLocation).Z;
-			
-			for (int32 i = 0; i <= Segment; i++)
-			{
-				const float Fraction = static_cast<float>(i) / static_cast<float>(Segment);
-				const float FractionZ = FMath::Lerp<float, float>(0, TargetLocation.Z - StartLocation.Z, Fraction);
-				const float Value = ParabolaCurve->GetFloatValue(Fraction);
-				ZCurve.AddKey(Fraction, OffsetZ * Value - FractionZ);
-			}
-
-		}
-		
-		PathCurve->FloatCurves[2] = ZCurve;
-	}
-
-	MoveToForce->TargetLocation = Target;
+	MoveToForce->TargetLocation = TargetLocation;
+	MoveToForce->ParabolaCurve = ParabolaCurve;
+	MoveToForce->ParabolaHeight = ParabolaHeight;
 	MoveToForce->TimeMappingCurve = TimeMappingCurve;
-	MoveToForce->PathOffsetCurve = PathCurve;
 	MoveToForce->FinishVelocityParams.Mode = static_cast<ERootMotionFinishVelocityMode>(static_cast<uint8>(Setting.
 		VelocityOnFinishMode));
 	MoveToForce->FinishVelocityParams.SetVelocity = Setting.FinishSetVelocity;
 	MoveToForce->FinishVelocityParams.ClampVelocity = Setting.FinishClampVelocity;
 	MoveToForce->SetTime(StartTime);
 	MoveToForce->RotationSetting = RotationSetting;
+	//位移只用原曲线, 保证与PredictRootMotionSourceLocation_MoveToParabola完全一致
+	MoveToForce->CurveLUTs.Build(nullptr, nullptr, RotationSetting.Curve);
 	return MovementComponent->ApplyRootMotionSource(MoveToForce);
 }
 
@@ -309,14 +325,12 @@ int32 URMSLibrary::ApplyRootMotionSource_PathMoveToForce(UCharacterMovementCompo
 		return -1;
 	}
 
-	TSharedPtr<FRootMotionSource_PathMoveToForce> PathMoveTo = MakeShared<
-		FRootMotionSource_PathMoveToForce>();
+	TSharedPtr<FRootMotionSource_PathMoveToForce> PathMoveTo(new FRootMotionSource_PathMoveToForce());
 	PathMoveTo->InstanceName = InstanceName == NAME_None ? TEXT("PathMoveTo") : InstanceName;
 	PathMoveTo->AccumulateMode = ExtraSetting.AccumulateMod;
 	PathMoveTo->Settings.SetFlag(
 		static_cast<ERootMotionSourceSettingsFlags>(static_cast<uint8>(ExtraSetting.SourcesSetting)));
 	PathMoveTo->Priority = NewPriority;
-	PathMoveTo->Path = Path;
 	PathMoveTo->StartLocation = StartLocation;
 	PathMoveTo->Duration = FMath::Max(Duration, KINDA_SMALL_NUMBER);
 	PathMoveTo->FinishVelocityParams.Mode = static_cast<ERootMotionFinishVelocityMode>(static_cast<uint8>(ExtraSetting.
@@ -325,6 +339,11 @@ int32 URMSLibrary::ApplyRootMotionSource_PathMoveToForce(UCharacterMovementCompo
 	PathMoveTo->FinishVelocityParams.ClampVelocity = ExtraSetting.FinishClampVelocity;
 	PathMoveTo->SetTime(StartTime);
 	PathMoveTo->StartRotation = StartRotation;
+	for (FRMSPathMoveToData& Data : Path)
+	{
+		PrepareReplicatedPathOffset(*MovementComponent, Data.PathOffsetCurve, Data.PathOffset);
+	}
+	PathMoveTo->SetPath(MoveTemp(Path));
 	return MovementComponent->ApplyRootMotionSource(PathMoveTo);
 }
 
@@ -343,8 +362,7 @@ if (!MovementComponent || Duration <= 0 || PathNum<2)
 	{
 		return -1;
 	}
-	TSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation> MoveToForce = MakeShared<
-		FRootMotionSource_MoveToDynamicForce_WithRotation>();
+	TSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation> MoveToForce(new FRootMotionSource_MoveToDynamicForce_WithRotation());
 	MoveToForce->InstanceName = InstanceName == NAME_None ? TEXT("PathMoveToV2") : InstanceName;
 	MoveToForce->AccumulateMode = Setting.AccumulateMod;
 	MoveToForce->Settings.SetFlag(
@@ -356,9 +374,6 @@ if (!MovementComponent || Duration <= 0 || PathNum<2)
 	MoveToForce->bRestrictSpeedToExpected = Setting.bRestrictSpeedToExpected;
 	MoveToForce->TargetLocation = Path.Last();
 
-	UCurveVector* PathCurve = NewObject<UCurveVector>();
-	const bool bUseTotalOffset = false;
-	
 	if (PathNum>2)
 	{
 		auto SetCurve_Lambda = [=](FRichCurve& Curve, float Time, float Value, ERichCurveTangentMode Tangent, ERichCurveInterpMode Interp)
@@ -395,19 +410,19 @@ if (!MovementComponent || Duration <= 0 || PathNum<2)
 		SetCurve_Lambda(YCurve,1,0,TangentMode,InterpMode);
 		SetCurve_Lambda(ZCurve,1,0,TangentMode,InterpMode);
 
-		
-		PathCurve->FloatCurves[0] = XCurve;
-		PathCurve->FloatCurves[1] = YCurve;
-		PathCurve->FloatCurves[2] = ZCurve;
+		//切线模式只在应用时起作用, 每段路点之间按固定数量采样
+		MoveToForce->PathOffset = FRMSPathCurve::Sample(XCurve, YCurve, ZCurve,
+		                                                (PathNum - 1) * PathCurveSamplesPerWaypoint + 1);
+		PrepareReplicatedPathOffset(*MovementComponent, MoveToForce->PathOffsetCurve, MoveToForce->PathOffset);
 	}
 	
-	MoveToForce->PathOffsetCurve = PathCurve;
 	MoveToForce->FinishVelocityParams.Mode = static_cast<ERootMotionFinishVelocityMode>(static_cast<uint8>(Setting.
 		VelocityOnFinishMode));
 	MoveToForce->FinishVelocityParams.SetVelocity = Setting.FinishSetVelocity;
 	MoveToForce->FinishVelocityParams.ClampVelocity = Setting.FinishClampVelocity;
 	MoveToForce->SetTime(StartTime);
 	MoveToForce->RotationSetting = RotationSetting;
+	MoveToForce->BuildCurveLUTs();
 	return MovementComponent->ApplyRootMotionSource(MoveToForce);
 	
 }
@@ -460,8 +475,7 @@ bool URMSLibrary::ApplyRootMotionSource_SimpleAnimation_BM(UCharacterMovementCom
 	const FTransform TargetTransformWS = Mesh2CharInverse * RootMotionWS;
 
 
-	//用动态曲线的方式 , 而非静态,
-	UCurveVector* OffsetCV = NewObject<UCurveVector>();
+	//先用临时曲线记录每一帧的偏移, 最后采样成FRMSPathCurve
 	FRichCurve CurveX, CurveY, CurveZ;
 	/*
 	 *遍历每一帧获取当前动画的RootMotion位置,
@@ -469,16 +483,19 @@ bool URMSLibrary::ApplyRootMotionSource_SimpleAnimation_BM(UCharacterMovementCom
 	 *计算动画与期望位置的比率
 	 *乘以之前的曲线偏移值得到最终的偏移值
 	 */
-	for (float CurrentTime = StartTime; CurrentTime <= EndTime; CurrentTime += FrameTime)
+	const FRotator RMSRotation = UKismetMathLibrary::MakeRotFromXZ(
+		TargetTransformWS.GetLocation() - StartFootTransform.GetLocation(), FVector(0, 0, 1));
+	const FTransform RMSSpaceTM{RMSRotation, StartFootTransform.GetLocation()};
+	const FVector FinalTargetRMS = RMSSpaceTM.InverseTransformPosition(TargetTransformWS.GetLocation());
+	TArray<FTransform> RootMotionTrack;
+	ExtractRootMotionTrack(DataAnimation, StartTime, EndTime, FrameTime, RootMotionTrack);
+	int32 FrameIndex = 0;
+	for (float CurrentTime = StartTime; CurrentTime <= EndTime; CurrentTime += FrameTime, FrameIndex++)
 	{
 		float Fraction = (CurrentTime - StartTime) / Duration;
-		const FTransform CurrFrameRootMotion = DataAnimation->ExtractRootMotion(0, CurrentTime, false);
+		const FTransform& CurrFrameRootMotion = RootMotionTrack[FrameIndex];
 		const FTransform CurrFrameRootMotionWS = CurrFrameRootMotion * MeshTransformWS;
 		const FTransform CurrFrameActorRootMotionWS = Mesh2CharInverse * CurrFrameRootMotionWS;
-		FRotator RMSRotation = UKismetMathLibrary::MakeRotFromXZ(
-			TargetTransformWS.GetLocation() - StartFootTransform.GetLocation(), FVector(0, 0, 1));
-		FTransform RMSSpaceTM{RMSRotation, StartFootTransform.GetLocation()};
-		const FVector FinalTargetRMS = RMSSpaceTM.InverseTransformPosition(TargetTransformWS.GetLocation());
 		const FVector CurrFrameActorRootMotionRMS = RMSSpaceTM.InverseTransformPosition(
 			CurrFrameActorRootMotionWS.GetLocation());
 
@@ -491,6 +508,7 @@ bool URMSLibrary::ApplyRootMotionSource_SimpleAnimation_BM(UCharacterMovementCom
 		CurveZ.AddKey(CurrentTime / Duration / Rate, CurveOffset.Z);
 
 
+#if RMS_DEBUG
 		if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 		{
 			//动画每一帧位置
@@ -500,21 +518,21 @@ bool URMSLibrary::ApplyRootMotionSource_SimpleAnimation_BM(UCharacterMovementCom
 				Character->GetCapsuleComponent()->GetScaledCapsuleRadius(),
 				FRotator::ZeroRotator, FColor::Red, 5, 0.1);
 		}
+#endif
 	}
-	OffsetCV->FloatCurves[0] = CurveX;
-	OffsetCV->FloatCurves[1] = CurveY;
-	if (!bIgnoreZAxis)
+	if (bIgnoreZAxis)
 	{
-		OffsetCV->FloatCurves[2] = CurveZ;
+		CurveZ.Reset();
 	}
+	const FRMSPathCurve PathOffset = FRMSPathCurve::Sample(CurveX, CurveY, CurveZ, RootMotionTrack.Num());
 	FVector WorldTarget = TargetTransformWS.GetLocation() + FVector(0, 0, HalfHeight);
 
 	FRMSSetting_Move Setting;
 	Setting.VelocityOnFinishMode = ERMSFinishVelocityMode::MaintainLastRootMotionVelocity;
 	FName InsName = InstanceName == NAME_None ? TEXT("SimpleAnimation") : InstanceName;
-	return ApplyRootMotionSource_MoveToForce(MovementComponent, InsName, StartLocation, WorldTarget,
-	                                         Duration / Rate, Priority, OffsetCV, FRMSRotationSetting(), StartTime,
-	                                         ERMSApplyMode::Replace, Setting) >= 0;
+	return ApplyRootMotionSource_MoveToForce_Path(MovementComponent, InsName, StartLocation, WorldTarget,
+	                                              Duration / Rate, Priority, PathOffset, FRMSRotationSetting(),
+	                                              StartTime, ERMSApplyMode::Replace, Setting) >= 0;
 }
 
 
@@ -565,8 +583,7 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationAdjustment_BM(
 	FTransform Mesh2Char = Mesh->GetComponentTransform().GetRelativeTransform(StartFootTransform);
 	Mesh2Char.SetLocation(FVector::ZeroVector);
 	const FVector TargetLocationActorSpace = (RootMotion * Mesh2Char).GetLocation();
-	//用动态曲线的方式 , 而非静态,
-	UCurveVector* OffsetCV = NewObject<UCurveVector>();
+	//先用临时曲线记录每一帧的偏移, 最后采样成FRMSPathCurve
 	FRichCurve CurveX, CurveY, CurveZ;
 	FVector WorldFootTarget = bTargetBasedOnFoot ? TargetLocation : TargetLocation - FVector(0, 0, HalfHeight);
 	WorldFootTarget = bLocalTarget ? StartFootTransform.TransformPosition(TargetLocation) : WorldFootTarget;
@@ -577,22 +594,21 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationAdjustment_BM(
 	 *计算动画与期望位置的比率
 	 *乘以之前的曲线偏移值得到最终的偏移值
 	 */
-	for (float CurrentTime = 0; CurrentTime <= EndTime; CurrentTime += FrameTime)
+	//创建RMS空间矩阵
+	const FRotator RMSRotation = UKismetMathLibrary::MakeRotFromXZ(WorldFootTarget - StartFootTransform.GetLocation(),
+	                                                               FVector(0, 0, 1));
+	const FTransform RMSSpaceTM{RMSRotation, StartFootTransform.GetLocation()};
+	//将所需的位置信息转换至RMS空间
+	const FVector FinalTargetRMS = RMSSpaceTM.InverseTransformPosition(WorldFootTarget);
+	const FVector FinalActorRootMotionRMS = TargetLocationActorSpace;
+	TArray<FTransform> RootMotionTrack;
+	ExtractRootMotionTrack(DataAnimation, 0, EndTime, FrameTime, RootMotionTrack);
+	int32 FrameIndex = 0;
+	for (float CurrentTime = 0; CurrentTime <= EndTime; CurrentTime += FrameTime, FrameIndex++)
 	{
 		float Fraction = CurrentTime / EndTime;
 		//获取当前时间的rootMotion
-		const FTransform CurrFrameRootMotion = DataAnimation->ExtractRootMotion(0, CurrentTime, false);
-		const FTransform CurrFrameActorRootMotionActorSpace = CurrFrameRootMotion * Mesh2Char;
-		const FVector CurrFrameActorRootMotionWS = StartFootTransform.TransformPosition(
-			CurrFrameActorRootMotionActorSpace.GetLocation());;
-		//创建RMS空间矩阵
-		FRotator RMSRotation = UKismetMathLibrary::MakeRotFromXZ(WorldFootTarget - StartFootTransform.GetLocation(),
-		                                                         FVector(0, 0, 1));
-		FTransform RMSSpaceTM{RMSRotation, StartFootTransform.GetLocation()};
-
-		//将所需的位置信息转换至RMS空间
-		const FVector FinalTargetRMS = RMSSpaceTM.InverseTransformPosition(WorldFootTarget);
-		const FVector FinalActorRootMotionRMS = TargetLocationActorSpace;
+		const FTransform& CurrFrameRootMotion = RootMotionTrack[FrameIndex];
 		const FVector CurrFrameActorRootMotionRMS = (CurrFrameRootMotion * Mesh2Char).GetLocation();
 
 		FVector FinalTargetRMSLinearFraction = FinalTargetRMS * Fraction;
@@ -613,19 +629,18 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationAdjustment_BM(
 	}
 
 
-	OffsetCV->FloatCurves[0] = CurveX;
-	OffsetCV->FloatCurves[1] = CurveY;
-	OffsetCV->FloatCurves[2] = CurveZ;
+	const FRMSPathCurve PathOffset = FRMSPathCurve::Sample(CurveX, CurveY, CurveZ, RootMotionTrack.Num());
 	FName InsName = InstanceName == NAME_None ? TEXT("AnimationAdjustment") : InstanceName;
 	const float Duration = EndTime / Rate;
+#if RMS_DEBUG
 	if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 	{
 		for (int32 i = 0; i <= 10; i++)
 		{
 			FVector PredictLoc;
-			if (PredictRootMotionSourceLocation_MoveTo(PredictLoc, MovementComponent, StartLocation,
-			                                           WorldFootTarget + FVector(0, 0, HalfHeight), Duration,
-			                                           Duration * (i / 10.0f), OffsetCV))
+			if (PredictRootMotionSourceLocation_MoveToPath(PredictLoc, StartLocation,
+			                                               WorldFootTarget + FVector(0, 0, HalfHeight), Duration,
+			                                               Duration * (i / 10.0f), PathOffset))
 			{
 				//动画每一帧位置
 				UKismetSystemLibrary::DrawDebugCapsule(Character, PredictLoc,
@@ -642,11 +657,12 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationAdjustment_BM(
 		                                       FRotator::ZeroRotator,
 		                                       FColor::Blue, 5);
 	}
+#endif
 
 
-	return ApplyRootMotionSource_MoveToForce(MovementComponent, InsName, StartLocation,
-	                                         WorldFootTarget + FVector(0, 0, HalfHeight), Duration,
-	                                         Priority, OffsetCV, RotationSetting, InStartTime) >= 0;
+	return ApplyRootMotionSource_MoveToForce_Path(MovementComponent, InsName, StartLocation,
+	                                              WorldFootTarget + FVector(0, 0, HalfHeight), Duration,
+	                                              Priority, PathOffset, RotationSetting, InStartTime) >= 0;
 }
 
 bool URMSLibrary::ApplyRootMotionSource_AnimationAdjustment(UCharacterMovementComponent* MovementComponent,
@@ -711,7 +727,7 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationAdjustment(UCharacterMovementCo
 	{
 		WorldTarget = TargetLocation - (bTargetBasedOnFoot ? FVector::ZeroVector : FVector(0, 0, HalfHeight));
 	}
-	TSharedPtr<FRootMotionSource_AnimWarping_FinalPoint> RMS = MakeShared<FRootMotionSource_AnimWarping_FinalPoint>();
+	TSharedPtr<FRootMotionSource_AnimWarping_FinalPoint> RMS(new FRootMotionSource_AnimWarping_FinalPoint());
 	RMS->InstanceName = InstanceName == NAME_None ? TEXT("MotioWarping") : InstanceName;
 
 	RMS->AccumulateMode = ERootMotionAccumulateMode::Override;
@@ -787,6 +803,12 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationWarping_ForwardCalculation(
 		auto EmplaceTriggerData_Lambda = [&]()
 		{
 			TriggerData.WindowData = Windows[idx];
+			//重叠的窗口从上一个的结尾开始, 保持按时间排序且不重叠, 重叠部分仍然属于前一个窗口
+			if (TriggerDatas.Num() > 0)
+			{
+				TriggerData.WindowData.StartTime = FMath::Max(TriggerData.WindowData.StartTime,
+				                                              TriggerDatas.Last().WindowData.EndTime);
+			}
 			const auto Target = WarpingTarget.Find(Windows[idx].AnimNotify->RootMotionSourceTarget);
 			if (Target)
 			{
@@ -860,8 +882,7 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationWarping_ForwardCalculation(
 	}
 
 
-	//用动态曲线的方式 , 而非静态,
-	UCurveVector* OffsetCV = NewObject<UCurveVector>();
+	//先用临时曲线记录每一帧的偏移, 最后采样成FRMSPathCurve
 	FRichCurve CurveX, CurveY, CurveZ;
 	//开始位置
 	FVector StartLocation = Character->GetActorLocation();
@@ -937,20 +958,25 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationWarping_ForwardCalculation(
 	TotalAnimRM = TotalAnimRM * Mesh2Char;
 
 
+#if RMS_DEBUG
 	if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 	{
 		//绘制最后目标
 		UKismetSystemLibrary::DrawDebugSphere(
 			Mesh, WorldTarget, 20.f, 12, FColor::Purple, 5, 1);
 	}
+#endif
 
 	//最终目标的RootMotion
 	FinalTargetAnimRM = DataAnimation->ExtractRootMotion(0, AnimLength, false);
 	FinalTargetAnimRM = FinalTargetAnimRM * Mesh2Char;
 
 	FVector CurveOffset = FVector::ZeroVector;
+	TArray<FTransform> RootMotionTrack;
+	ExtractRootMotionTrack(DataAnimation, 0, AnimLength, FrameTime, RootMotionTrack);
+	int32 FrameIndex = 0;
 	//逐帧遍历
-	for (float CurrentTime = 0; CurrentTime <= AnimLength; CurrentTime += FrameTime)
+	for (float CurrentTime = 0; CurrentTime <= AnimLength; CurrentTime += FrameTime, FrameIndex++)
 	{
 		//todo 需要区分缩放时间和真实的时间, 真实时间用于提取动画RM数据
 		const float TimeScaled = CurrentTime / Rate;
@@ -981,8 +1007,7 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationWarping_ForwardCalculation(
 		float Fraction = TimeScaled / Duration;
 
 		//获取当前时间段的rootMotion
-		CurrFrameAnimRM = DataAnimation->ExtractRootMotion(0, CurrentTime, false);
-		CurrFrameAnimRM = CurrFrameAnimRM * Mesh2Char;
+		CurrFrameAnimRM = RootMotionTrack[FrameIndex] * Mesh2Char;
 
 		bool bHasWarpingTarget = false;
 
@@ -1054,6 +1079,7 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationWarping_ForwardCalculation(
 		CurveZ.AddKey(TimeScaled / Duration, CurveOffset.Z);
 
 
+#if RMS_DEBUG
 		if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 		{
 			//动画每一帧位置
@@ -1083,17 +1109,15 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationWarping_ForwardCalculation(
 				Mesh, StartLocation + FinalLinearOffset + Offset - FVector(0, 0, HalfHeight),
 				5.0, 4, FColor::Blue, 5.0);
 		}
+#endif
 		LastTime = CurrentTime;
 	}
-	OffsetCV->FloatCurves[0] = CurveX;
-	OffsetCV->FloatCurves[1] = CurveY;
-	OffsetCV->FloatCurves[2] = CurveZ;
+	const FRMSPathCurve PathOffset = FRMSPathCurve::Sample(CurveX, CurveY, CurveZ, RootMotionTrack.Num());
 
 	InstanceName = InstanceName == NAME_None ? TEXT("AnimWarping") : InstanceName;
 	//用MoveToForce来计算路径, 尝试过用Jump+OffsetCv, 但是Jump的CV不好用
-	return ApplyRootMotionSource_MoveToForce(MovementComponent, InstanceName, StartLocation, WorldTarget, Duration,
-	                                         Priority,
-	                                         OffsetCV) >= 0;
+	return ApplyRootMotionSource_MoveToForce_Path(MovementComponent, InstanceName, StartLocation, WorldTarget,
+	                                              Duration, Priority, PathOffset) >= 0;
 }
 
 bool URMSLibrary::ApplyRootMotionSource_AnimationWarping(UCharacterMovementComponent* MovementComponent,
@@ -1281,6 +1305,7 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationWarping(UCharacterMovementCompo
 		return false;
 	}
 
+#if RMS_DEBUG
 	if (RMS::CVarRMS_Debug.GetValueOnGameThread() > 0)
 	{
 		for (int32 i = 0; i < TriggerDatas.Num(); i++)
@@ -1298,14 +1323,14 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationWarping(UCharacterMovementCompo
 			                 1);
 		}
 	}
-	TSharedPtr<FRootMotionSource_AnimWarping_MultiTargets> RMS = MakeShared<
-		FRootMotionSource_AnimWarping_MultiTargets>();
+#endif
+	TSharedPtr<FRootMotionSource_AnimWarping_MultiTargets> RMS(new FRootMotionSource_AnimWarping_MultiTargets());
 	RMS->InstanceName = InstanceName == NAME_None ? TEXT("MotioWarping") : InstanceName;
 
 	RMS->AccumulateMode = ERootMotionAccumulateMode::Override;
 	RMS->Priority = NewPriority;
 	//这个目标必须是脚底位置
-	RMS->TriggerDatas = TriggerDatas;
+	RMS->SetTriggerDatas(MoveTemp(TriggerDatas));
 	RMS->StartLocation = Character->GetActorLocation();
 	RMS->StartRotation = Character->GetActorRotation();
 	RMS->Duration = Duration;
@@ -1320,23 +1345,15 @@ bool URMSLibrary::ApplyRootMotionSource_AnimationWarping(UCharacterMovementCompo
 bool URMSLibrary::GetRootMotionSourceWindow(UAnimSequence* DataAnimation, FName InstanceName,
                                             FRMSWindowData& Window)
 {
-	if (!DataAnimation)
+	const FRMSWindowIndexPtr Index = FRMSAnimationCache::Get().FindOrBuildWindowIndex(DataAnimation);
+	if (!Index.IsValid())
 	{
 		return false;
 	}
-	const auto Notifies = DataAnimation->Notifies;
-	for (auto Noti : Notifies)
+	if (const FRMSWindowData* Found = Index->FindByName(InstanceName))
 	{
-		if (UAnimNotifyState_RMS_Warping* RMSNoti = Cast<UAnimNotifyState_RMS_Warping>(Noti.NotifyStateClass))
-		{
-			if (RMSNoti->RootMotionSourceTarget == InstanceName)
-			{
-				Window.AnimNotify = RMSNoti;
-				Window.StartTime = Noti.GetTriggerTime();
-				Window.EndTime = Noti.GetEndTriggerTime();
-				return true;
-			}
-		}
+		Window = *Found;
+		return true;
 	}
 	return false;
 }
@@ -1344,22 +1361,12 @@ bool URMSLibrary::GetRootMotionSourceWindow(UAnimSequence* DataAnimation, FName
 bool URMSLibrary::GetRootMotionSourceWindows(UAnimSequence* DataAnimation,
                                              TArray<FRMSWindowData>& Windows)
 {
-	if (!DataAnimation)
+	const FRMSWindowIndexPtr Index = FRMSAnimationCache::Get().FindOrBuildWindowIndex(DataAnimation);
+	if (!Index.IsValid())
 	{
 		return false;
 	}
-	const auto Notifies = DataAnimation->Notifies;
-	for (auto Noti : Notifies)
-	{
-		if (UAnimNotifyState_RMS_Warping* RMSNoti = Cast<UAnimNotifyState_RMS_Warping>(Noti.NotifyStateClass))
-		{
-			FRMSWindowData Window;
-			Window.AnimNotify = RMSNoti;
-			Window.StartTime = Noti.GetTriggerTime();
-			Window.EndTime = Noti.GetEndTriggerTime();
-			Windows.Emplace(Window);
-		}
-	}
+	Windows.Append(Index->Windows);
 	return Windows.Num() > 0;
 }
 
@@ -1367,19 +1374,20 @@ bool URMSLibrary::GetRootMotionSourceWindowsByInstanceList(UAnimSequence* DataAn
                                                            TArray<FName> Instances,
                                                            TArray<FRMSWindowData>& Windows)
 {
-	if (!DataAnimation)
+	const FRMSWindowIndexPtr Index = FRMSAnimationCache::Get().FindOrBuildWindowIndex(DataAnimation);
+	if (!Index.IsValid())
 	{
 		return false;
 	}
-	for (auto Ins : Instances)
+	Windows.Reserve(Windows.Num() + Instances.Num());
+	for (const FName& Ins : Instances)
 	{
-		FRMSWindowData Window;
-		if (GetRootMotionSourceWindow(DataAnimation, Ins, Window))
+		if (const FRMSWindowData* Found = Index->FindByName(Ins))
 		{
-			Windows.Emplace(Window);
+			Windows.Add(*Found);
 		}
 	}
-	Windows.Sort([](FRMSWindowData A, FRMSWindowData B)
+	Windows.Sort([](const FRMSWindowData& A, const FRMSWindowData& B)
 	{
 		return A.StartTime < B.StartTime;
 	});
@@ -1393,13 +1401,15 @@ bool URMSLibrary::FindTriggerDataByTime(const TArray<FRMSNotifyTriggerData>& Tri
 	{
 		return false;
 	}
-	for (auto T : TriggerData)
+	//二分查找最后一个StartTime <= Time的窗口, 前提见声明
+	const int32 Upper = Algo::UpperBoundBy(TriggerData, Time, [](const FRMSNotifyTriggerData& T)
 	{
-		if (Time >= T.WindowData.StartTime && Time < T.WindowData.EndTime)
-		{
-			OutData = T;
-			return true;
-		}
+		return T.WindowData.StartTime;
+	});
+	if (Upper > 0 && Time < TriggerData[Upper - 1].WindowData.EndTime)
+	{
+		OutData = TriggerData[Upper - 1];
+		return true;
 	}
 	return false;
 }
@@ -1419,6 +1429,42 @@ FTransform URMSLibrary::ExtractRootMotion(UAnimSequenceBase* Anim, float StartTi
 	return OutTransform;
 }
 
+void URMSLibrary::ExtractRootMotionTrack(UAnimSequenceBase* Anim, float StartTime, float EndTime, float FrameTime,
+                                         TArray<FTransform>& OutTrack)
+{
+	OutTrack.Reset();
+	if (!Anim || FrameTime <= 0)
+	{
+		return;
+	}
+	//逐帧累加相邻两帧之间的RootMotion, 不再每次从0开始提取
+	//不使用烘焙数据: 烘焙采样之间是插值结果, 生成的路径要与逐帧提取保持一致
+	float LastTime = 0;
+	FTransform Accumulated = FTransform::Identity;
+	for (float CurrentTime = StartTime; CurrentTime <= EndTime; CurrentTime += FrameTime)
+	{
+		Accumulated = ExtractRootMotion(Anim, LastTime, CurrentTime) * Accumulated;
+		Accumulated.NormalizeRotation();
+		OutTrack.Add(Accumulated);
+		LastTime = CurrentTime;
+	}
+}
+
+int32 URMSLibrary::BakeAnimationRootMotionData(const TArray<UAnimSequenceBase*>& Animations, float SampleRate)
+{
+	int32 Num = 0;
+#if WITH_EDITOR
+	for (UAnimSequenceBase* Animation : Animations)
+	{
+		if (URMSAnimationAssetUserData::BakeToAsset(Animation, SampleRate))
+		{
+			Num++;
+		}
+	}
+#endif
+	return Num;
+}
+
 
 bool URMSLibrary::ApplyRootMotionSource_SimpleAnimation(UCharacterMovementComponent* MovementComponent,
                                                         UAnimSequence* DataAnimation,
@@ -1449,7 +1495,7 @@ bool URMSLibrary::ApplyRootMotionSource_SimpleAnimation(UCharacterMovementCompon
 		                          ? DataAnimation->GetPlayLength()
 		                          : EndTime;
 	const float Duration = (CurrEndTime - StartTime) / FMath::Max(Rate, 0.1f);
-	TSharedPtr<FRootMotionSource_AnimWarping> RMS = MakeShared<FRootMotionSource_AnimWarping>();
+	TSharedPtr<FRootMotionSource_AnimWarping> RMS(new FRootMotionSource_AnimWarping());
 	RMS->InstanceName = InstanceName == NAME_None ? TEXT("MotioWarping") : InstanceName;
 	RMS->AccumulateMode = ERootMotionAccumulateMode::Override;
 	RMS->Priority = NewPriority;
@@ -1545,30 +1591,13 @@ int32 URMSLibrary::ApplyRootMotionSource_RadialForece(UCharacterMovementComponen
 void URMSLibrary::UpdateDynamicMoveToTarget(UCharacterMovementComponent* MovementComponent,
                                             FName InstanceName, FVector NewTarget)
 {
-	if (MovementComponent && !NewTarget.ContainsNaN())
+	if (MovementComponent && MovementComponent->GetCharacterOwner() && !NewTarget.ContainsNaN())
 	{
-		auto RMS = MovementComponent->GetRootMotionSource(InstanceName);
-		if (!RMS)
-		{
-			return;
-		}
-		auto RMS_Dy = StaticCastSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation>(RMS);
-		if (!RMS_Dy)
-		{
-			return;
-		}
-		if (NewTarget.Equals(RMS_Dy->TargetLocation, 0.1))
+		if (auto RMS_Dy = GetDynamicMoveToWithRotationRootMotionSource(MovementComponent, InstanceName))
 		{
-			return;
+			//默认立即Retarget, UpdatePolicy开启合并时在下一次移动Tick开始时
+			RMS_Dy->RequestTargetLocation(*MovementComponent->GetCharacterOwner(), NewTarget);
 		}
-		//为了防止跳跃, 我们需要重新设定Start和Time
-		const float Time = RMS_Dy->GetTime();
-		const float Duration = RMS_Dy->GetDuration();
-		RMS_Dy->SetTime(0);
-		RMS_Dy->Duration = Duration - Time;
-		RMS_Dy->StartLocation = MovementComponent->GetOwner()->GetActorLocation();
-		RMS_Dy->StartRotation = MovementComponent->GetOwner()->GetActorRotation();
-		RMS_Dy->SetTargetLocation(NewTarget);
 	}
 }
 
@@ -1585,27 +1614,38 @@ void URMSLibrary::RemoveRootMotionSource(UCharacterMovementComponent* MovementCo
 void URMSLibrary::UpdateDynamicMoveDuration(UCharacterMovementComponent* MovementComponent,
                                             FName InstanceName, float NewDuration)
 {
-	if (MovementComponent && NewDuration > 0)
+	if (MovementComponent && MovementComponent->GetCharacterOwner() && NewDuration > 0)
 	{
-		auto RMS = MovementComponent->GetRootMotionSource(InstanceName);
-		if (!RMS)
-		{
-			return;
-		}
-		auto RMS_Dy = StaticCastSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation>(RMS);
-		if (!RMS_Dy)
-		{
-			return;
-		}
-		const float CurrTime = RMS_Dy->GetTime();
-		if (NewDuration <= CurrTime)
+		if (auto RMS_Dy = GetDynamicMoveToWithRotationRootMotionSource(MovementComponent, InstanceName))
 		{
-			return;
+			RMS_Dy->RequestDuration(*MovementComponent->GetCharacterOwner(), NewDuration);
 		}
-		RMS_Dy->Duration = NewDuration - CurrTime;
-		RMS_Dy->SetTime(0);
-		RMS_Dy->StartLocation = MovementComponent->GetOwner()->GetActorLocation();
-		RMS_Dy->StartRotation = MovementComponent->GetOwner()->GetActorRotation();
+	}
+}
+
+void URMSLibrary::SetDynamicMoveUpdatePolicy(UCharacterMovementComponent* MovementComponent, FName InstanceName,
+                                             const FRMSDynamicUpdatePolicy& Policy)
+{
+	if (auto RMS_Dy = GetDynamicMoveToWithRotationRootMotionSource(MovementComponent, InstanceName))
+	{
+		RMS_Dy->UpdatePolicy = Policy;
+	}
+}
+
+void URMSLibrary::RegisterNetAnimations(const TArray<UAnimSequenceBase*>& Animations)
+{
+	RMSNetQuantize::RegisterAnimations(Animations);
+}
+
+void URMSLibrary::GetDynamicMoveUpdateStats(UCharacterMovementComponent* MovementComponent, FName InstanceName,
+                                            int32& AppliedUpdates, int32& SuppressedUpdates)
+{
+	AppliedUpdates = 0;
+	SuppressedUpdates = 0;
+	if (auto RMS_Dy = GetDynamicMoveToWithRotationRootMotionSource(MovementComponent, InstanceName))
+	{
+		AppliedUpdates = RMS_Dy->AppliedUpdates;
+		SuppressedUpdates = RMS_Dy->SuppressedUpdates;
 	}
 }
 
@@ -1654,6 +1694,21 @@ TSharedPtr<FRootMotionSource_MoveToDynamicForce> URMSLibrary::GetDynamicMoveToRo
 	return nullptr;
 }
 
+TSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation> URMSLibrary::GetDynamicMoveToWithRotationRootMotionSource(
+	UCharacterMovementComponent* MovementComponent, FName InstanceName)
+{
+	if (MovementComponent)
+	{
+		auto RMS = MovementComponent->GetRootMotionSource(InstanceName);
+		//按名字可能找到其他类型的RMS, 不能直接转换
+		if (RMS && RMS->GetScriptStruct()->IsChildOf(FRootMotionSource_MoveToDynamicForce_WithRotation::StaticStruct()))
+		{
+			return StaticCastSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation>(RMS);
+		}
+	}
+	return nullptr;
+}
+
 TSharedPtr<FRootMotionSource> URMSLibrary::GetRootMotionSourceByID(
 	UCharacterMovementComponent* MovementComponent, int32 ID)
 {
@@ -1830,7 +1885,7 @@ bool URMSLibrary::ExtractRotation(FRotator& OutRotation, const ACharacter& Chara
 bool URMSLibrary::PredictRootMotionSourceLocation_Runtime(UCharacterMovementComponent* MovementComponent,
                                                           FName InstanceName, float Time, FVector& OutLocation)
 {
-	if (!MovementComponent)
+	if (!MovementComponent || !MovementComponent->GetCharacterOwner())
 	{
 		return false;
 	}
@@ -1839,58 +1894,134 @@ bool URMSLibrary::PredictRootMotionSourceLocation_Runtime(UCharacterMovementComp
 	{
 		return false;
 	}
+	return SampleRootMotionSourceTrajectory(*RMS, *MovementComponent->GetCharacterOwner(), MakeArrayView(&Time, 1),
+	                                        MakeArrayView(&OutLocation, 1));
+}
 
-	if (auto RMS_MoveToDy = StaticCastSharedPtr<FRootMotionSource_MoveToDynamicForce>(RMS))
+bool URMSLibrary::SampleRootMotionSourceTrajectory(const FRootMotionSource& RootMotionSource,
+                                                   const ACharacter& Character, TConstArrayView<float> Times,
+                                                   TArrayView<FVector> OutLocations)
+{
+	if (Times.Num() != OutLocations.Num())
+	{
+		return false;
+	}
+	//子类要在父类之前判断
+	const UScriptStruct* ScriptStruct = RootMotionSource.GetScriptStruct();
+	if (ScriptStruct->IsChildOf(FRootMotionSource_AnimWarping::StaticStruct()))
+	{
+		return static_cast<const FRootMotionSource_AnimWarping&>(RootMotionSource).SampleTrajectory(
+			Character, Times, OutLocations);
+	}
+	if (ScriptStruct->IsChildOf(FRootMotionSource_MoveToDynamicForce_WithRotation::StaticStruct()))
+	{
+		return static_cast<const FRootMotionSource_MoveToDynamicForce_WithRotation&>(RootMotionSource).
+			SampleTrajectory(Character, Times, OutLocations);
+	}
+	if (ScriptStruct->IsChildOf(FRootMotionSource_MoveToForce_WithRotation::StaticStruct()))
+	{
+		return static_cast<const FRootMotionSource_MoveToForce_WithRotation&>(RootMotionSource).SampleTrajectory(
+			Character, Times, OutLocations);
+	}
+	if (ScriptStruct->IsChildOf(FRootMotionSource_PathMoveToForce::StaticStruct()))
 	{
-		float Fraction = Time / RMS_MoveToDy->GetDuration();
-		if (RMS_MoveToDy->TimeMappingCurve)
+		return static_cast<const FRootMotionSource_PathMoveToForce&>(RootMotionSource).SampleTrajectory(
+			Character, Times, OutLocations);
+	}
+	if (ScriptStruct->IsChildOf(FRootMotionSource_JumpForce_WithPoints::StaticStruct()))
+	{
+		return static_cast<const FRootMotionSource_JumpForce_WithPoints&>(RootMotionSource).SampleTrajectory(
+			Character, Times, OutLocations);
+	}
+
+	//引擎自带的RMS
+	const float Duration = RootMotionSource.GetDuration();
+	auto GetTimeFraction = [Duration](float Time)
+	{
+		return Duration > SMALL_NUMBER ? FMath::Clamp(Time / Duration, 0.f, 1.f) : 1.f;
+	};
+	if (ScriptStruct->IsChildOf(FRootMotionSource_MoveToDynamicForce::StaticStruct()))
+	{
+		const auto& MoveToDy = static_cast<const FRootMotionSource_MoveToDynamicForce&>(RootMotionSource);
+		for (int32 i = 0; i < Times.Num(); i++)
 		{
-			Fraction = EvaluateFloatCurveAtFraction(*RMS_MoveToDy->TimeMappingCurve, Fraction);
+			float Fraction = GetTimeFraction(Times[i]);
+			if (MoveToDy.TimeMappingCurve)
+			{
+				Fraction = EvaluateFloatCurveAtFraction(*MoveToDy.TimeMappingCurve, Fraction);
+			}
+			OutLocations[i] = FMath::Lerp<FVector, float>(MoveToDy.StartLocation, MoveToDy.TargetLocation, Fraction) +
+				MoveToDy.GetPathOffsetInWorldSpace(Fraction);
 		}
-		const FVector PathOffset = RMS_MoveToDy->GetPathOffsetInWorldSpace(Fraction);
-		const FVector CurrentTargetLocation = FMath::Lerp<FVector, float>(
-			RMS_MoveToDy->StartLocation, RMS_MoveToDy->TargetLocation, Fraction);
-		OutLocation = CurrentTargetLocation + PathOffset;
 		return true;
 	}
-	else if (auto RMS_MoveTo = StaticCastSharedPtr<FRootMotionSource_MoveToForce>(RMS))
+	if (ScriptStruct->IsChildOf(FRootMotionSource_MoveToForce::StaticStruct()))
 	{
-		const float Fraction = Time / RMS_MoveTo->GetDuration();
-		FVector PathOffset = FVector::ZeroVector;
-		if (RMS_MoveTo->PathOffsetCurve)
+		const auto& MoveTo = static_cast<const FRootMotionSource_MoveToForce&>(RootMotionSource);
+		for (int32 i = 0; i < Times.Num(); i++)
 		{
-			PathOffset = RMS_MoveTo->GetPathOffsetInWorldSpace(Fraction);
+			const float Fraction = GetTimeFraction(Times[i]);
+			OutLocations[i] = FMath::Lerp<FVector, float>(MoveTo.StartLocation, MoveTo.TargetLocation, Fraction) +
+				MoveTo.GetPathOffsetInWorldSpace(Fraction);
 		}
-		const FVector CurrentTargetLocation = FMath::Lerp<FVector, float>(
-			RMS_MoveTo->StartLocation, RMS_MoveTo->TargetLocation, Fraction);
-		OutLocation = CurrentTargetLocation + PathOffset;
 		return true;
 	}
-	else if (auto RMS_Jump = StaticCastSharedPtr<FRootMotionSource_JumpForce>(RMS))
+	if (ScriptStruct->IsChildOf(FRootMotionSource_JumpForce::StaticStruct()))
 	{
-		float Fraction = Time / RMS_Jump->GetDuration();
-		if (RMS_Jump->TimeMappingCurve)
+		//JumpForce没有记录起点, 以角色当前位置对应当前时间
+		const auto& Jump = static_cast<const FRootMotionSource_JumpForce&>(RootMotionSource);
+		auto GetMoveFraction = [&Jump, &GetTimeFraction](float Time)
 		{
-			float MinCurveTime(0.f);
-			float MaxCurveTime(1.f);
-			//
-			// RMS_Jump->TimeMappingCurve->GetTimeRange(MinCurveTime, MaxCurveTime);
-			//
-			// Fraction =  RMS_Jump->TimeMappingCurve->GetFloatValue(FMath::GetRangeValue(FVector2D(MinCurveTime, MaxCurveTime), Fraction));
-
-			Fraction = EvaluateFloatCurveAtFraction(*RMS_Jump->TimeMappingCurve, Fraction);
-			const FVector TargetRelativeLocation = RMS_Jump->GetRelativeLocation(Fraction);
-			if (MovementComponent->GetOwner())
-			{
-				OutLocation = MovementComponent->GetOwner()->GetActorLocation() + TargetRelativeLocation;
-				return true;
-			}
+			const float Fraction = GetTimeFraction(Time);
+			return Jump.TimeMappingCurve ? EvaluateFloatCurveAtFraction(*Jump.TimeMappingCurve, Fraction) : Fraction;
+		};
+		const FVector CurrentRelativeLocation = Jump.GetRelativeLocation(GetMoveFraction(Jump.GetTime()));
+		for (int32 i = 0; i < Times.Num(); i++)
+		{
+			OutLocations[i] = Character.GetActorLocation() + Jump.GetRelativeLocation(GetMoveFraction(Times[i])) -
+				CurrentRelativeLocation;
 		}
+		return true;
 	}
-
 	return false;
 }
 
+bool URMSLibrary::SampleRootMotionSourceTrajectory_Times(UCharacterMovementComponent* MovementComponent,
+                                                         FName InstanceName, const TArray<float>& Times,
+                                                         TArray<FVector>& OutLocations)
+{
+	OutLocations.Reset();
+	if (!MovementComponent || !MovementComponent->GetCharacterOwner())
+	{
+		return false;
+	}
+	auto RMS = GetRootMotionSource(MovementComponent, InstanceName);
+	if (!RMS.IsValid())
+	{
+		return false;
+	}
+	OutLocations.SetNumUninitialized(Times.Num());
+	if (!SampleRootMotionSourceTrajectory(*RMS, *MovementComponent->GetCharacterOwner(), Times, OutLocations))
+	{
+		OutLocations.Reset();
+		return false;
+	}
+	return true;
+}
+
+bool URMSLibrary::SampleRootMotionSourceTrajectory_FixedStep(UCharacterMovementComponent* MovementComponent,
+                                                             FName InstanceName, float StartTime, float DeltaTime,
+                                                             int32 NumSamples, TArray<FVector>& OutLocations)
+{
+	TArray<float> Times;
+	Times.SetNumUninitialized(FMath::Max(NumSamples, 0));
+	for (int32 i = 0; i < Times.Num(); i++)
+	{
+		Times[i] = StartTime + DeltaTime * i;
+	}
+	return SampleRootMotionSourceTrajectory_Times(MovementComponent, InstanceName, Times, OutLocations);
+}
+
 
 bool URMSLibrary::PredictRootMotionSourceLocation_MoveTo(FVector& OutLocation,
                                                          UCharacterMovementComponent* MovementComponent,
@@ -1917,6 +2048,25 @@ bool URMSLibrary::PredictRootMotionSourceLocation_MoveTo(FVector& OutLocation,
 	return true;
 }
 
+bool URMSLibrary::PredictRootMotionSourceLocation_MoveToPath(FVector& OutLocation, FVector StartLocation,
+                                                             FVector TargetLocation, float Duration, float Time,
+                                                             const FRMSPathCurve& PathOffset)
+{
+	if (Duration <= 0 || Time < 0 || Time > Duration)
+	{
+		return false;
+	}
+	const float Fraction = Time / Duration;
+	OutLocation = FMath::Lerp<FVector, float>(StartLocation, TargetLocation, Fraction);
+	if (PathOffset.IsValid())
+	{
+		FRotator FacingRotation((TargetLocation - StartLocation).Rotation());
+		FacingRotation.Pitch = 0.f;
+		OutLocation += FacingRotation.RotateVector(PathOffset.Evaluate(Fraction));
+	}
+	return true;
+}
+
 bool URMSLibrary::PredictRootMotionSourceLocation_Jump(FVector& OutLocation,
                                                        UCharacterMovementComponent* MovementComponent,
                                                        FVector StartLocation, float Distance, float Height,
@@ -1967,27 +2117,20 @@ bool URMSLibrary::PredictRootMotionSourceLocation_MoveToParabola(FVector& OutLoc
                                                                  , float Duration
                                                                  , float CurrentTime
                                                                  , UCurveFloat* ParabolaCurve
-                                                                 , UCurveFloat* TimeMappingCurve)
+                                                                 , UCurveFloat* TimeMappingCurve
+                                                                 , float ParabolaHeight)
 {
 	if (!MovementComponent || Duration <= 0 || CurrentTime < 0 || CurrentTime > Duration)
 	{
 		return false;
 	}
 	float Fraction = CurrentTime / Duration;
-	FVector CurrentTargetLocation = FMath::Lerp<FVector, float>(StartLocation, TargetLocation, Fraction);
 	if (TimeMappingCurve)
 	{
 		Fraction = EvaluateFloatCurveAtFraction(*TimeMappingCurve, Fraction);
 	}
-	if (ParabolaCurve)
-	{
-		const float Z = (TargetLocation - StartLocation).Z;
-		const float CurveValue = EvaluateFloatCurveAtFraction(*ParabolaCurve, Fraction);
-		CurrentTargetLocation.Z = StartLocation.Z + CurveValue * Z;
-	}
-	OutLocation = CurrentTargetLocation;
+	OutLocation = FRootMotionSource_MoveToForce_Parabola::GetParabolaLocation(
+		StartLocation, TargetLocation, ParabolaCurve, ParabolaHeight, Fraction);
 
 	return true;
 }
-
-UE_ENABLE_OPTIMIZATION
@@ -2,19 +2,21 @@
 //  https://supervj.top/2022/03/24/RootMotionSource/
 
 #include "RMSModule.h"
+#include "RMSAnimationCache.h"
 
 #define LOCTEXT_NAMESPACE "FRMSModule"
 
 void FRMSModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
-
+	FRMSAnimationCache::Get().Startup();
 }
 
 void FRMSModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FRMSAnimationCache::Get().Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,768 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+
+#include "RMSNetQuantize.h"
+#include "RMSLibrary.h"
+#include "Animation/AnimSequenceBase.h"
+#include "Curves/CurveVector.h"
+#include "Engine/NetSerialization.h"
+#include "HAL/IConsoleManager.h"
+#include "Hash/CityHash.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+#include "UObject/ObjectKey.h"
+
+namespace RMSNetQuantize
+{
+namespace
+{
+FORCEINLINE uint32 ZigZagEncode(int32 Value)
+{
+	return (static_cast<uint32>(Value) << 1) ^ static_cast<uint32>(Value >> 31);
+}
+
+FORCEINLINE int32 ZigZagDecode(uint32 Value)
+{
+	return static_cast<int32>(Value >> 1) ^ -static_cast<int32>(Value & 1);
+}
+
+FORCEINLINE void SerializeOptionalAxis(FArchive& Ar, double& Axis)
+{
+	uint16 Short = Ar.IsSaving() ? FRotator::CompressAxisToShort(Axis) : 0;
+	uint8 bHasValue = Short != 0;
+	Ar.SerializeBits(&bHasValue, 1);
+	if (bHasValue)
+	{
+		Ar << Short;
+	}
+	if (Ar.IsLoading())
+	{
+		Axis = bHasValue ? FRotator::DecompressAxisFromShort(Short) : 0.f;
+	}
+}
+
+FORCEINLINE int32 QuantizeOffset(float Value)
+{
+	return FMath::RoundToInt(Value / LocationTolerance);
+}
+
+//数组长度, 太长时认为数据错误
+FORCEINLINE bool SerializeNum(FArchive& Ar, int32& Num)
+{
+	static constexpr uint32 MaxNum = 1024;
+	uint32 PackedNum = static_cast<uint32>(Num);
+	Ar.SerializeIntPacked(PackedNum);
+	if (PackedNum > MaxNum)
+	{
+		Ar.SetError();
+		return false;
+	}
+	Num = static_cast<int32>(PackedNum);
+	return true;
+}
+
+//注册的动画表, 只会追加, 下标在进程内保持不变
+struct FAnimationTable
+{
+	FRWLock Lock;
+	TArray<TWeakObjectPtr<UAnimSequenceBase>> Animations;
+	//与Animations一一对应的路径校验, 发现两端注册顺序不一致
+	TArray<uint16> Checks;
+	TMap<FObjectKey, int32> Indices;
+};
+
+FORCEINLINE uint16 GetAnimationCheck(const UAnimSequenceBase* Animation)
+{
+	return static_cast<uint16>(FCrc::StrCrc32(*Animation->GetPathName()));
+}
+
+FAnimationTable& GetAnimationTable()
+{
+	static FAnimationTable Table;
+	return Table;
+}
+}
+
+bool SerializeVersion(FArchive& Ar)
+{
+	uint8 SerializedVersion = Version;
+	Ar << SerializedVersion;
+	if (SerializedVersion != Version)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("RMS NetSerialize version mismatch, received %u, expected %u"),
+		       SerializedVersion, Version);
+		Ar.SetError();
+		return false;
+	}
+	return true;
+}
+
+bool SerializeLocation(FArchive& Ar, FVector& Location)
+{
+	return SerializePackedVector<10, 24>(Location, Ar);
+}
+
+bool SerializeOffset(FArchive& Ar, FVector& Location, const FVector& Origin)
+{
+	//两端都以量化后的Origin为基准, 接收端得到的就是量化后的Location, 逐点相对编码时误差不会累积
+	const FVector QuantizedOrigin = QuantizeLocation(Origin);
+	FVector Offset = Ar.IsSaving() ? Location - QuantizedOrigin : FVector::ZeroVector;
+	const bool bSuccess = SerializePackedVector<10, 24>(Offset, Ar);
+	if (Ar.IsLoading())
+	{
+		Location = QuantizedOrigin + Offset;
+	}
+	return bSuccess;
+}
+
+void SerializeRotator(FArchive& Ar, FRotator& Rotator)
+{
+	uint16 Yaw = Ar.IsSaving() ? FRotator::CompressAxisToShort(Rotator.Yaw) : 0;
+	Ar << Yaw;
+	SerializeOptionalAxis(Ar, Rotator.Pitch);
+	SerializeOptionalAxis(Ar, Rotator.Roll);
+	if (Ar.IsLoading())
+	{
+		Rotator.Yaw = FRotator::DecompressAxisFromShort(Yaw);
+	}
+}
+
+void SerializeTime(FArchive& Ar, float& Time)
+{
+	int32 Milliseconds = Ar.IsSaving() ? FMath::RoundToInt(Time / TimeTolerance) : 0;
+	SerializeInt(Ar, Milliseconds);
+	if (Ar.IsLoading())
+	{
+		Time = Milliseconds * TimeTolerance;
+	}
+}
+
+void SerializeInt(FArchive& Ar, int32& Value)
+{
+	uint32 Packed = ZigZagEncode(Value);
+	Ar.SerializeIntPacked(Packed);
+	Value = ZigZagDecode(Packed);
+}
+
+void RegisterAnimations(const TArray<UAnimSequenceBase*>& Animations)
+{
+	FAnimationTable& Table = GetAnimationTable();
+	FWriteScopeLock WriteLock(Table.Lock);
+	for (UAnimSequenceBase* Animation : Animations)
+	{
+		if (Animation && !Table.Indices.Contains(Animation))
+		{
+			Table.Indices.Add(Animation, Table.Animations.Add(Animation));
+			Table.Checks.Add(GetAnimationCheck(Animation));
+		}
+	}
+}
+
+int32 FindAnimationIndex(const UAnimSequenceBase* Animation)
+{
+	if (!Animation)
+	{
+		return INDEX_NONE;
+	}
+	FAnimationTable& Table = GetAnimationTable();
+	FReadScopeLock ReadLock(Table.Lock);
+	const int32* Found = Table.Indices.Find(Animation);
+	return Found ? *Found : INDEX_NONE;
+}
+
+void SerializeAnimation(FArchive& Ar, TObjectPtr<UAnimSequenceBase>& Animation)
+{
+	//查找下标和读取校验在同一个锁里
+	FAnimationTable& Table = GetAnimationTable();
+	FReadScopeLock ReadLock(Table.Lock);
+	const int32* Found = Ar.IsSaving() && Animation ? Table.Indices.Find(FObjectKey(Animation.Get())) : nullptr;
+	uint8 bRegistered = Found != nullptr;
+	Ar.SerializeBits(&bRegistered, 1);
+	if (!bRegistered)
+	{
+		Ar << Animation;
+		return;
+	}
+	uint32 PackedIndex = Found ? static_cast<uint32>(*Found) : 0;
+	Ar.SerializeIntPacked(PackedIndex);
+	uint16 Check = Found ? Table.Checks[*Found] : 0;
+	Ar << Check;
+	if (Ar.IsLoading())
+	{
+		Animation = Table.Animations.IsValidIndex(PackedIndex) ? Table.Animations[PackedIndex].Get() : nullptr;
+		if (!Animation || Table.Checks[PackedIndex] != Check)
+		{
+			//两端注册的表不一致, 下标对应的不是同一个动画
+			UE_LOG(LogTemp, Warning, TEXT("RMS NetSerialize: animation index %u does not match the registered table"),
+			       PackedIndex);
+			Animation = nullptr;
+			Ar.SetError();
+		}
+	}
+}
+
+FFrameRate GetAnimationFrameRate(const UAnimSequenceBase* Animation)
+{
+	return Animation ? Animation->GetSamplingFrameRate() : FFrameRate(0, 0);
+}
+
+void SerializeFrameTime(FArchive& Ar, float& Time, const FFrameRate& Rate)
+{
+	int32 Frame = 0;
+	uint8 bOnFrame = 0;
+	if (Ar.IsSaving() && Rate.IsValid())
+	{
+		Frame = FMath::RoundToInt(Rate.AsDecimal() * Time);
+		//比毫秒精度更严格, 保证接收端与按时间发送时的误差相同
+		bOnFrame = FMath::IsNearlyEqual(Rate.AsSeconds(Frame), static_cast<double>(Time), TimeTolerance * 0.5);
+	}
+	Ar.SerializeBits(&bOnFrame, 1);
+	if (!bOnFrame)
+	{
+		SerializeTime(Ar, Time);
+		return;
+	}
+	SerializeInt(Ar, Frame);
+	if (Ar.IsLoading())
+	{
+		if (!Rate.IsValid())
+		{
+			Ar.SetError();
+			return;
+		}
+		Time = static_cast<float>(Rate.AsSeconds(Frame));
+	}
+}
+
+bool IsNetAddressable(const UObject* Curve)
+{
+	return Curve && Curve->IsSupportedForNetworking();
+}
+
+void WarnNotAddressable(const UObject* Curve)
+{
+#if RMS_DEBUG
+	static TSet<FObjectKey> WarnedCurves;
+	bool bAlreadyWarned = false;
+	WarnedCurves.Add(Curve, &bAlreadyWarned);
+	if (!bAlreadyWarned)
+	{
+		UE_LOG(LogTemp, Warning,
+		       TEXT("RMS NetSerialize: %s is not an asset and can not be replicated, clients will ignore it"),
+		       *GetPathNameSafe(Curve));
+	}
+#endif
+}
+
+void SerializeRotationSetting(FArchive& Ar, FRMSRotationSetting& Setting)
+{
+	Ar << Setting.Mode;
+	if (Setting.Mode == ERMSRotationMode::None)
+	{
+		//没有旋转时其他参数不起作用
+		return;
+	}
+	SerializeAssetCurve(Ar, Setting.Curve);
+	Ar << Setting.WarpMultiplier;
+	if (Setting.Mode == ERMSRotationMode::Custom)
+	{
+		SerializeRotator(Ar, Setting.TargetRotation);
+	}
+}
+
+void SerializePathCurve(FArchive& Ar, FRMSPathCurve& PathCurve)
+{
+	int32 Num = PathCurve.Samples.Num();
+	if (!SerializeNum(Ar, Num))
+	{
+		return;
+	}
+	if (Ar.IsLoading())
+	{
+		PathCurve.Samples.SetNumUninitialized(Num);
+	}
+	//在定点数上做差分, 误差不会累积
+	FIntVector Last = FIntVector::ZeroValue;
+	for (FVector3f& Sample : PathCurve.Samples)
+	{
+		//读取时Sample还没有初始化, 不能量化
+		FIntVector Quantized = Ar.IsSaving()
+			                       ? FIntVector(QuantizeOffset(Sample.X), QuantizeOffset(Sample.Y),
+			                                    QuantizeOffset(Sample.Z))
+			                       : Last;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			int32 Delta = Quantized[Axis] - Last[Axis];
+			SerializeInt(Ar, Delta);
+			Quantized[Axis] = Last[Axis] + Delta;
+		}
+		if (Ar.IsLoading())
+		{
+			Sample = FVector3f(Quantized.X, Quantized.Y, Quantized.Z) * LocationTolerance;
+		}
+		Last = Quantized;
+	}
+}
+
+void SerializePathOffset(FArchive& Ar, TObjectPtr<UCurveVector>& Curve, FRMSPathCurve& PathOffset)
+{
+	enum class EPathOffsetMode : uint8
+	{
+		None,
+		Asset,
+		Samples,
+	};
+	uint8 Mode = static_cast<uint8>(EPathOffsetMode::None);
+	if (Ar.IsSaving())
+	{
+		if (PathOffset.IsValid() || (Curve && !IsNetAddressable(Curve)))
+		{
+			Mode = static_cast<uint8>(EPathOffsetMode::Samples);
+		}
+		else if (Curve)
+		{
+			Mode = static_cast<uint8>(EPathOffsetMode::Asset);
+		}
+	}
+	Ar.SerializeBits(&Mode, 2);
+
+	switch (static_cast<EPathOffsetMode>(Mode))
+	{
+	case EPathOffsetMode::Asset:
+		Ar << Curve;
+		if (Ar.IsLoading())
+		{
+			PathOffset.Reset();
+		}
+		break;
+	case EPathOffsetMode::Samples:
+		if (Ar.IsSaving() && !PathOffset.IsValid())
+		{
+			FRMSPathCurve Sampled = FRMSPathCurve::Sample(*Curve, RMS::CVarRMS_NetCurveSamples.GetValueOnAnyThread());
+			SerializePathCurve(Ar, Sampled);
+		}
+		else
+		{
+			SerializePathCurve(Ar, PathOffset);
+		}
+		if (Ar.IsLoading())
+		{
+			Curve = nullptr;
+		}
+		break;
+	default:
+		if (Ar.IsLoading())
+		{
+			Curve = nullptr;
+			PathOffset.Reset();
+		}
+		break;
+	}
+}
+
+bool SerializePath(FArchive& Ar, TArray<FRMSPathMoveToData>& Path, const FVector& Origin)
+{
+	int32 Num = Path.Num();
+	if (!SerializeNum(Ar, Num))
+	{
+		return false;
+	}
+	if (Ar.IsLoading())
+	{
+		Path.SetNum(Num);
+	}
+	bool bSuccess = true;
+	FVector LastTarget = Origin;
+	for (FRMSPathMoveToData& Data : Path)
+	{
+		SerializeTime(Ar, Data.Duration);
+		bSuccess &= SerializeOffset(Ar, Data.Target, LastTarget);
+		SerializePathOffset(Ar, Data.PathOffsetCurve, Data.PathOffset);
+		SerializeAssetCurve(Ar, Data.TimeMappingCurve);
+		SerializeRotationSetting(Ar, Data.RotationSetting);
+		LastTarget = Data.Target;
+	}
+	return bSuccess;
+}
+
+bool SerializeTargets(FArchive& Ar, TArray<FRMSTarget>& Targets, const FVector& Origin, const FFrameRate& Rate)
+{
+	int32 Num = Targets.Num();
+	if (!SerializeNum(Ar, Num))
+	{
+		return false;
+	}
+	if (Ar.IsLoading())
+	{
+		Targets.SetNum(Num);
+	}
+	bool bSuccess = true;
+	FVector LastTarget = Origin;
+	for (FRMSTarget& Target : Targets)
+	{
+		SerializeFrameTime(Ar, Target.StartTime, Rate);
+		SerializeFrameTime(Ar, Target.EndTime, Rate);
+		bSuccess &= SerializeOffset(Ar, Target.Target, LastTarget);
+		SerializeRotationSetting(Ar, Target.RotationSetting);
+		LastTarget = Target.Target;
+	}
+	return bSuccess;
+}
+
+bool RotationSettingEquals(const FRMSRotationSetting& A, const FRMSRotationSetting& B)
+{
+	if (A.Mode != B.Mode)
+	{
+		return false;
+	}
+	if (A.Mode == ERMSRotationMode::None)
+	{
+		return true;
+	}
+	return AssetCurveEquals(A.Curve, B.Curve) && A.WarpMultiplier == B.WarpMultiplier &&
+		(A.Mode != ERMSRotationMode::Custom || RotatorEquals(A.TargetRotation, B.TargetRotation));
+}
+
+bool PathCurveEquals(const FRMSPathCurve& A, const FRMSPathCurve& B)
+{
+	if (A.Samples.Num() != B.Samples.Num())
+	{
+		return false;
+	}
+	for (int32 i = 0; i < A.Samples.Num(); i++)
+	{
+		if (!A.Samples[i].Equals(B.Samples[i], LocationTolerance))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool PathOffsetEquals(const UCurveVector* CurveA, const FRMSPathCurve& PathA, const UCurveVector* CurveB,
+                      const FRMSPathCurve& PathB)
+{
+	if (PathA.IsValid() && PathB.IsValid())
+	{
+		return PathCurveEquals(PathA, PathB);
+	}
+	if (!PathA.IsValid() && !PathB.IsValid())
+	{
+		return CurveA == CurveB;
+	}
+	const UCurveVector* Curve = PathA.IsValid() ? CurveB : CurveA;
+	const FRMSPathCurve& Path = PathA.IsValid() ? PathA : PathB;
+	if (!Curve)
+	{
+		return false;
+	}
+	//采样误差加上量化误差
+	const float Tolerance = LocationTolerance * 2.f;
+	for (int32 i = 0; i < Path.Samples.Num(); i++)
+	{
+		const FVector Value = URMSLibrary::EvaluateVectorCurveAtFraction(
+			*Curve, static_cast<float>(i) / (Path.Samples.Num() - 1));
+		if (!Value.Equals(FVector(Path.Samples[i]), Tolerance))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool PathEquals(const TArray<FRMSPathMoveToData>& A, const TArray<FRMSPathMoveToData>& B)
+{
+	if (A.Num() != B.Num())
+	{
+		return false;
+	}
+	for (int32 i = 0; i < A.Num(); i++)
+	{
+		if (!TimeEquals(A[i].Duration, B[i].Duration) ||
+			!LocationEquals(A[i].Target, B[i].Target) ||
+			!AssetCurveEquals(A[i].TimeMappingCurve, B[i].TimeMappingCurve) ||
+			!RotationSettingEquals(A[i].RotationSetting, B[i].RotationSetting) ||
+			!PathOffsetEquals(A[i].PathOffsetCurve, A[i].PathOffset, B[i].PathOffsetCurve, B[i].PathOffset))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FFingerprint::AddLocation(const FVector& Location)
+{
+	//与QuantizeLocation相同的网格
+	AddInt(FMath::RoundToInt64(Location.X * 10.0));
+	AddInt(FMath::RoundToInt64(Location.Y * 10.0));
+	AddInt(FMath::RoundToInt64(Location.Z * 10.0));
+}
+
+void FFingerprint::AddRotator(const FRotator& Rotator)
+{
+	AddInt(FRotator::CompressAxisToShort(Rotator.Pitch));
+	AddInt(FRotator::CompressAxisToShort(Rotator.Yaw));
+	AddInt(FRotator::CompressAxisToShort(Rotator.Roll));
+}
+
+void FFingerprint::AddTime(float Time)
+{
+	AddInt(FMath::RoundToInt(Time / TimeTolerance));
+}
+
+void FFingerprint::AddObject(const UObject* Object)
+{
+	AddInt(IsNetAddressable(Object) ? static_cast<int64>(reinterpret_cast<UPTRINT>(Object)) : 0);
+}
+
+void FFingerprint::AddRotationSetting(const FRMSRotationSetting& Setting)
+{
+	AddInt(static_cast<int64>(Setting.Mode));
+	if (Setting.Mode == ERMSRotationMode::None)
+	{
+		return;
+	}
+	AddObject(Setting.Curve);
+	//WarpMultiplier按原始值发送
+	uint32 WarpMultiplierBits;
+	FMemory::Memcpy(&WarpMultiplierBits, &Setting.WarpMultiplier, sizeof(WarpMultiplierBits));
+	AddInt(WarpMultiplierBits);
+	if (Setting.Mode == ERMSRotationMode::Custom)
+	{
+		AddRotator(Setting.TargetRotation);
+	}
+}
+
+void FFingerprint::AddPathOffset(const UCurveVector* Curve, const FRMSPathCurve& PathOffset)
+{
+	if (!PathOffset.IsValid() && !Curve)
+	{
+		AddInt(0);
+		return;
+	}
+	if (!PathOffset.IsValid() && IsNetAddressable(Curve))
+	{
+		AddInt(1);
+		AddObject(Curve);
+		return;
+	}
+	AddInt(2);
+	const FRMSPathCurve Sampled = PathOffset.IsValid()
+		                              ? FRMSPathCurve()
+		                              : FRMSPathCurve::Sample(*Curve, RMS::CVarRMS_NetCurveSamples.GetValueOnAnyThread());
+	const FRMSPathCurve& Samples = PathOffset.IsValid() ? PathOffset : Sampled;
+	AddInt(Samples.Samples.Num());
+	for (const FVector3f& Sample : Samples.Samples)
+	{
+		AddInt(QuantizeOffset(Sample.X));
+		AddInt(QuantizeOffset(Sample.Y));
+		AddInt(QuantizeOffset(Sample.Z));
+	}
+}
+
+uint64 FFingerprint::Get() const
+{
+	return CityHash64(reinterpret_cast<const char*>(Words.GetData()), Words.Num() * sizeof(int64));
+}
+
+uint64 HashPath(const TArray<FRMSPathMoveToData>& Path)
+{
+	FFingerprint Fingerprint;
+	Fingerprint.AddInt(Path.Num());
+	for (const FRMSPathMoveToData& Data : Path)
+	{
+		Fingerprint.AddTime(Data.Duration);
+		Fingerprint.AddLocation(Data.Target);
+		Fingerprint.AddObject(Data.TimeMappingCurve);
+		Fingerprint.AddRotationSetting(Data.RotationSetting);
+		Fingerprint.AddPathOffset(Data.PathOffsetCurve, Data.PathOffset);
+	}
+	return Fingerprint.Get();
+}
+
+uint64 HashTargets(const TArray<FRMSTarget>& Targets)
+{
+	FFingerprint Fingerprint;
+	Fingerprint.AddInt(Targets.Num());
+	for (const FRMSTarget& Target : Targets)
+	{
+		Fingerprint.AddTime(Target.StartTime);
+		Fingerprint.AddTime(Target.EndTime);
+		Fingerprint.AddLocation(Target.Target);
+		Fingerprint.AddRotationSetting(Target.RotationSetting);
+	}
+	return Fingerprint.Get();
+}
+
+bool TargetsEquals(const TArray<FRMSTarget>& A, const TArray<FRMSTarget>& B)
+{
+	if (A.Num() != B.Num())
+	{
+		return false;
+	}
+	for (int32 i = 0; i < A.Num(); i++)
+	{
+		if (!TimeEquals(A[i].StartTime, B[i].StartTime) ||
+			!TimeEquals(A[i].EndTime, B[i].EndTime) ||
+			!LocationEquals(A[i].Target, B[i].Target) ||
+			!RotationSettingEquals(A[i].RotationSetting, B[i].RotationSetting))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+}
+
+#if RMS_DEBUG
+namespace
+{
+void ValidateNetQuantize(const TArray<FString>& Args)
+{
+	const int32 Num = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1000;
+	FRandomStream Random(Num);
+	double MaxLocationError = 0, MaxOffsetError = 0, MaxRotationError = 0, MaxTimeError = 0, MaxPathError = 0;
+	int64 TotalBits = 0;
+	for (int32 i = 0; i < Num; i++)
+	{
+		FVector Location = Random.GetUnitVector() * Random.FRandRange(0.f, 200000.f);
+		FVector Target = Location + Random.GetUnitVector() * Random.FRandRange(0.f, 2000.f);
+		FRotator Rotation(Random.FRandRange(-90.f, 90.f), Random.FRandRange(-180.f, 180.f), 0.f);
+		float Time = Random.FRandRange(0.f, 10.f);
+		FRMSPathCurve PathCurve;
+		for (int32 Sample = 0; Sample < 9; Sample++)
+		{
+			PathCurve.Samples.Add(FVector3f(Random.GetUnitVector() * Random.FRandRange(0.f, 300.f)));
+		}
+
+		FBitWriter Writer(0, true);
+		RMSNetQuantize::SerializeVersion(Writer);
+		RMSNetQuantize::SerializeLocation(Writer, Location);
+		RMSNetQuantize::SerializeOffset(Writer, Target, Location);
+		RMSNetQuantize::SerializeRotator(Writer, Rotation);
+		RMSNetQuantize::SerializeTime(Writer, Time);
+		RMSNetQuantize::SerializePathCurve(Writer, PathCurve);
+		TotalBits += Writer.GetNumBits();
+
+		FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+		FVector OutLocation, OutTarget;
+		FRotator OutRotation;
+		float OutTime;
+		FRMSPathCurve OutPathCurve;
+		const bool bVersion = RMSNetQuantize::SerializeVersion(Reader);
+		RMSNetQuantize::SerializeLocation(Reader, OutLocation);
+		RMSNetQuantize::SerializeOffset(Reader, OutTarget, OutLocation);
+		RMSNetQuantize::SerializeRotator(Reader, OutRotation);
+		RMSNetQuantize::SerializeTime(Reader, OutTime);
+		RMSNetQuantize::SerializePathCurve(Reader, OutPathCurve);
+		if (!bVersion || Reader.IsError() || Reader.GetBitsLeft() != 0)
+		{
+			UE_LOG(LogTemp, Error, TEXT("RMS NetQuantize round trip failed at sample %d"), i);
+			return;
+		}
+		MaxLocationError = FMath::Max(MaxLocationError, (OutLocation - Location).GetAbsMax());
+		MaxOffsetError = FMath::Max(MaxOffsetError, ((OutTarget - OutLocation) - (Target - Location)).GetAbsMax());
+		MaxRotationError = FMath::Max(MaxRotationError, (OutRotation - Rotation).GetNormalized().GetManhattanDistance(
+			                              FRotator::ZeroRotator));
+		MaxTimeError = FMath::Max<double>(MaxTimeError, FMath::Abs(OutTime - Time));
+		for (int32 Sample = 0; Sample < PathCurve.Samples.Num(); Sample++)
+		{
+			MaxPathError = FMath::Max<double>(MaxPathError,
+			                                  (OutPathCurve.Samples[Sample] - PathCurve.Samples[Sample]).GetAbsMax());
+		}
+	}
+	UE_LOG(LogTemp, Log,
+	       TEXT("RMS NetQuantize %d samples, %.1f bits each, max error: location %f, offset %f, rotation %f, time %f, path %f"),
+	       Num, static_cast<double>(TotalBits) / Num, MaxLocationError, MaxOffsetError, MaxRotationError,
+	       MaxTimeError, MaxPathError);
+}
+
+FAutoConsoleCommand ValidateNetQuantizeCommand(
+	TEXT("RMS.ValidateNetQuantize"),
+	TEXT("Round trip random locations, rotations, times and path offsets through the RMS net quantization. Usage: RMS.ValidateNetQuantize [Num]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&ValidateNetQuantize));
+
+//AnimWarping_MultiTargets自己的数据在量化前后的位数, 父类FRootMotionSource的数据两边相同, 不计算
+void MeasureMultiTargetsNetSize(const TArray<FString>& Args)
+{
+	const int32 NumTargets = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 64) : 4;
+	const int32 Num = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 100;
+	TArray<UAnimSequenceBase*> Animations;
+	{
+		RMSNetQuantize::FAnimationTable& Table = RMSNetQuantize::GetAnimationTable();
+		FReadScopeLock ReadLock(Table.Lock);
+		for (const TWeakObjectPtr<UAnimSequenceBase>& Animation : Table.Animations)
+		{
+			if (Animation.IsValid())
+			{
+				Animations.Add(Animation.Get());
+			}
+		}
+	}
+	if (Animations.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("RMS MeasureMultiTargetsNetSize: no registered animation, call RegisterNetAnimations first"));
+		return;
+	}
+	FRandomStream Random(Num);
+	int64 TotalBitsBefore = 0, TotalBitsAfter = 0;
+	for (int32 i = 0; i < Num; i++)
+	{
+		TObjectPtr<UAnimSequenceBase> Animation = Animations[Random.RandHelper(Animations.Num())];
+		const FFrameRate FrameRate = RMSNetQuantize::GetAnimationFrameRate(Animation);
+		const int32 NumFrames = FMath::Max(FMath::FloorToInt(FrameRate.AsDecimal() * Animation->GetPlayLength()), 1);
+		FVector StartLocation = Random.GetUnitVector() * Random.FRandRange(0.f, 200000.f);
+		FRotator StartRotation(0.f, Random.FRandRange(-180.f, 180.f), 0.f);
+		float AnimStartTime = 0.f;
+		float AnimEndTime = static_cast<float>(FrameRate.AsSeconds(NumFrames));
+		float CachedEndTime = AnimEndTime;
+		bool bIgnoreZAxis = false;
+		FRMSRotationSetting RotationSetting;
+		//触发窗口与通知一样落在帧上
+		TArray<FRMSTarget> Targets;
+		FVector LastTarget = StartLocation;
+		for (int32 TargetIndex = 0; TargetIndex < NumTargets; TargetIndex++)
+		{
+			FRMSTarget& Target = Targets.AddDefaulted_GetRef();
+			const int32 StartFrame = NumFrames * TargetIndex / NumTargets;
+			const int32 EndFrame = NumFrames * (TargetIndex + 1) / NumTargets;
+			Target.StartTime = static_cast<float>(FrameRate.AsSeconds(StartFrame));
+			Target.EndTime = static_cast<float>(FrameRate.AsSeconds(EndFrame));
+			Target.Target = LastTarget + Random.GetUnitVector() * Random.FRandRange(0.f, 500.f);
+			LastTarget = Target.Target;
+		}
+
+		//量化之前的格式, 动画的对象引用需要PackageMap, 没有计算在内
+		FBitWriter Before(0, true);
+		Before << StartLocation << StartRotation << AnimStartTime << AnimEndTime << bIgnoreZAxis << CachedEndTime;
+		Before << RotationSetting;
+		Before << Targets;
+		TotalBitsBefore += Before.GetNumBits();
+
+		FBitWriter After(0, true);
+		RMSNetQuantize::SerializeVersion(After);
+		RMSNetQuantize::SerializeLocation(After, StartLocation);
+		RMSNetQuantize::SerializeRotator(After, StartRotation);
+		RMSNetQuantize::SerializeAnimation(After, Animation);
+		RMSNetQuantize::SerializeFrameTime(After, AnimStartTime, FrameRate);
+		RMSNetQuantize::SerializeFrameTime(After, AnimEndTime, FrameRate);
+		After << bIgnoreZAxis;
+		RMSNetQuantize::SerializeFrameTime(After, CachedEndTime, FrameRate);
+		RMSNetQuantize::SerializeRotationSetting(After, RotationSetting);
+		RMSNetQuantize::SerializeTargets(After, Targets, StartLocation, FrameRate);
+		TotalBitsAfter += After.GetNumBits();
+	}
+	const double BitsBefore = static_cast<double>(TotalBitsBefore) / Num;
+	const double BitsAfter = static_cast<double>(TotalBitsAfter) / Num;
+	UE_LOG(LogTemp, Log,
+	       TEXT("RMS MultiTargets %d sources with %d targets: %.1f bits before (without the animation reference), %.1f bits after, %.1fx smaller"),
+	       Num, NumTargets, BitsBefore, BitsAfter, BitsAfter > 0 ? BitsBefore / BitsAfter : 0.0);
+}
+
+FAutoConsoleCommand MeasureMultiTargetsNetSizeCommand(
+	TEXT("RMS.MeasureMultiTargetsNetSize"),
+	TEXT("Compare the bits an AnimWarping_MultiTargets source takes before and after net quantization, using the registered animations. Usage: RMS.MeasureMultiTargetsNetSize [NumTargets] [Num]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&MeasureMultiTargetsNetSize));
+}
+#endif
@@ -0,0 +1,366 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+
+#include "RMSRootMotionLibrary.h"
+
+#include "AnimNotifyState_RMS.h"
+#include "RMSLibrary.h"
+#include "Animation/AnimSequence.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+
+static_assert(PLATFORM_LITTLE_ENDIAN, "RMSRootMotionLibrary is stored little endian");
+
+using namespace RMSRootMotionLibrary;
+
+namespace
+{
+FORCEINLINE float DecodeYaw(uint16 Yaw)
+{
+	return FRotator::DecompressAxisFromShort(Yaw);
+}
+
+FORCEINLINE FTransform DecodeSample(const FSample& Sample, float Scale)
+{
+	return FTransform(FRotator(0.f, DecodeYaw(Sample.Yaw), 0.f),
+	                  FVector(Sample.X, Sample.Y, Sample.Z) * Scale);
+}
+
+FORCEINLINE bool IsRangeValid(uint64 Offset, uint64 Size, int64 DataSize)
+{
+	return Offset + Size <= static_cast<uint64>(DataSize);
+}
+}
+
+FRMSRootMotionLibrary::~FRMSRootMotionLibrary()
+{
+	//先释放映射区域再关闭文件
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+}
+
+FRMSRootMotionLibraryPtr FRMSRootMotionLibrary::LoadFromFile(const FString& Filename)
+{
+	FRMSRootMotionLibraryPtr Library = MakeShareable(new FRMSRootMotionLibrary());
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	Library->MappedHandle.Reset(PlatformFile.OpenMapped(*Filename));
+	if (Library->MappedHandle)
+	{
+		Library->MappedRegion.Reset(Library->MappedHandle->MapRegion(0, Library->MappedHandle->GetFileSize()));
+	}
+	if (Library->MappedRegion)
+	{
+		if (!Library->Initialize(Library->MappedRegion->GetMappedPtr(), Library->MappedRegion->GetMappedSize()))
+		{
+			return nullptr;
+		}
+		return Library;
+	}
+	//平台不支持内存映射的话读到内存中
+	TArray<uint8> FileData;
+	if (!FFileHelper::LoadFileToArray(FileData, *Filename))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Can not load root motion library %s"), *Filename);
+		return nullptr;
+	}
+	return LoadFromMemory(MoveTemp(FileData));
+}
+
+FRMSRootMotionLibraryPtr FRMSRootMotionLibrary::LoadFromMemory(TArray<uint8>&& InData)
+{
+	FRMSRootMotionLibraryPtr Library = MakeShareable(new FRMSRootMotionLibrary());
+	Library->OwnedData = MoveTemp(InData);
+	if (!Library->Initialize(Library->OwnedData.GetData(), Library->OwnedData.Num()))
+	{
+		return nullptr;
+	}
+	return Library;
+}
+
+bool FRMSRootMotionLibrary::Initialize(const uint8* InData, int64 InSize)
+{
+	if (!InData || InSize < static_cast<int64>(sizeof(FHeader)))
+	{
+		return false;
+	}
+	const FHeader* InHeader = reinterpret_cast<const FHeader*>(InData);
+	if (InHeader->Magic != RMSRootMotionLibrary::Magic || InHeader->Version != RMSRootMotionLibrary::Version)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Root motion library version mismatch, need rebuild"));
+		return false;
+	}
+	if (!IsRangeValid(sizeof(FHeader), uint64(InHeader->NumClips) * sizeof(FClipEntry), InSize)
+		|| !IsRangeValid(InHeader->StringTableOffset, InHeader->StringTableSize, InSize))
+	{
+		return false;
+	}
+	const FClipEntry* InClips = reinterpret_cast<const FClipEntry*>(InData + sizeof(FHeader));
+	for (uint32 i = 0; i < InHeader->NumClips; i++)
+	{
+		const FClipEntry& Clip = InClips[i];
+		//GetRootMotionAtTime按PlayLength做除法, 样本按TranslationScale缩放
+		if (Clip.NumSamples < 2
+			|| !FMath::IsFinite(Clip.PlayLength) || Clip.PlayLength <= 0.f
+			|| !FMath::IsFinite(Clip.TranslationScale)
+			|| !IsRangeValid(Clip.SampleOffset, uint64(Clip.NumSamples) * sizeof(FSample), InSize)
+			|| !IsRangeValid(Clip.WindowOffset, uint64(Clip.NumWindows) * sizeof(FWindowEntry), InSize)
+			|| Clip.NameOffset + uint64(Clip.NameLength) > InHeader->StringTableSize)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Root motion library clip %u is corrupt"), i);
+			return false;
+		}
+		//窗口名字同样指向字符串表, 损坏或者过期的文件会在GetWindows里越界
+		const FWindowEntry* InWindows = reinterpret_cast<const FWindowEntry*>(InData + Clip.WindowOffset);
+		for (uint32 WindowIndex = 0; WindowIndex < Clip.NumWindows; WindowIndex++)
+		{
+			if (InWindows[WindowIndex].NameOffset + uint64(InWindows[WindowIndex].NameLength) > InHeader->StringTableSize)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Root motion library clip %u window %u is corrupt"), i, WindowIndex);
+				return false;
+			}
+		}
+	}
+
+	Data = InData;
+	DataSize = InSize;
+	Header = InHeader;
+	Clips = InClips;
+	ClipIndexByName.Reserve(Header->NumClips);
+	for (uint32 i = 0; i < Header->NumClips; i++)
+	{
+		ClipIndexByName.Add(ReadName(Clips[i].NameOffset, Clips[i].NameLength), i);
+	}
+	return true;
+}
+
+FName FRMSRootMotionLibrary::ReadName(uint32 Offset, uint32 Length) const
+{
+	const ANSICHAR* Str = reinterpret_cast<const ANSICHAR*>(Data + Header->StringTableOffset + Offset);
+	const FUTF8ToTCHAR Converted(Str, Length);
+	return FName(Converted.Length(), Converted.Get());
+}
+
+int32 FRMSRootMotionLibrary::FindClip(FName ClipName) const
+{
+	const int32* Found = ClipIndexByName.Find(ClipName);
+	return Found ? *Found : INDEX_NONE;
+}
+
+int32 FRMSRootMotionLibrary::FindClip(const UAnimSequenceBase* Animation) const
+{
+	return Animation ? FindClip(FName(*Animation->GetPathName())) : INDEX_NONE;
+}
+
+FName FRMSRootMotionLibrary::GetClipName(int32 ClipIndex) const
+{
+	return ClipIndex >= 0 && ClipIndex < GetNumClips()
+		       ? ReadName(Clips[ClipIndex].NameOffset, Clips[ClipIndex].NameLength)
+		       : NAME_None;
+}
+
+float FRMSRootMotionLibrary::GetPlayLength(int32 ClipIndex) const
+{
+	return ClipIndex >= 0 && ClipIndex < GetNumClips() ? Clips[ClipIndex].PlayLength : 0.f;
+}
+
+FTransform FRMSRootMotionLibrary::GetRootMotionAtTime(const FClipEntry& Clip, float Time) const
+{
+	const FSample* Samples = reinterpret_cast<const FSample*>(Data + Clip.SampleOffset);
+	const float Pos = FMath::Clamp(Time / Clip.PlayLength, 0.f, 1.f) * (Clip.NumSamples - 1);
+	const int32 Index = FMath::Min(FMath::FloorToInt(Pos), static_cast<int32>(Clip.NumSamples) - 2);
+	const float Alpha = Pos - Index;
+	const FSample& A = Samples[Index];
+	const FSample& B = Samples[Index + 1];
+	const FVector Location = FMath::Lerp(FVector(A.X, A.Y, A.Z), FVector(B.X, B.Y, B.Z), Alpha) * Clip.TranslationScale;
+	const float YawA = DecodeYaw(A.Yaw);
+	const float Yaw = YawA + FMath::FindDeltaAngleDegrees(YawA, DecodeYaw(B.Yaw)) * Alpha;
+	return FTransform(FRotator(0.f, Yaw, 0.f), Location);
+}
+
+FTransform FRMSRootMotionLibrary::ExtractRootMotion(int32 ClipIndex, float StartTime, float EndTime) const
+{
+	if (ClipIndex < 0 || ClipIndex >= GetNumClips())
+	{
+		return FTransform::Identity;
+	}
+	const FClipEntry& Clip = Clips[ClipIndex];
+	return GetRootMotionAtTime(Clip, EndTime) * GetRootMotionAtTime(Clip, StartTime).Inverse();
+}
+
+void FRMSRootMotionLibrary::GetWindows(int32 ClipIndex, TArray<FRMSRootMotionLibraryWindow>& OutWindows) const
+{
+	if (ClipIndex < 0 || ClipIndex >= GetNumClips())
+	{
+		return;
+	}
+	const FClipEntry& Clip = Clips[ClipIndex];
+	const FWindowEntry* Windows = reinterpret_cast<const FWindowEntry*>(Data + Clip.WindowOffset);
+	OutWindows.Reserve(OutWindows.Num() + Clip.NumWindows);
+	for (uint32 i = 0; i < Clip.NumWindows; i++)
+	{
+		FRMSRootMotionLibraryWindow& Window = OutWindows.AddDefaulted_GetRef();
+		Window.RootMotionSourceTarget = ReadName(Windows[i].NameOffset, Windows[i].NameLength);
+		Window.StartTime = Windows[i].StartTime;
+		Window.EndTime = Windows[i].EndTime;
+	}
+}
+
+FRMSBakedRootMotionPtr FRMSRootMotionLibrary::MakeBakedRootMotion(int32 ClipIndex) const
+{
+	if (ClipIndex < 0 || ClipIndex >= GetNumClips())
+	{
+		return nullptr;
+	}
+	const FClipEntry& Clip = Clips[ClipIndex];
+	const FSample* Samples = reinterpret_cast<const FSample*>(Data + Clip.SampleOffset);
+	TSharedPtr<FRMSBakedRootMotion, ESPMode::ThreadSafe> Baked = MakeShared<FRMSBakedRootMotion, ESPMode::ThreadSafe>();
+	Baked->bFromAssetData = true;
+	Baked->SampleRate = Header->SampleRate;
+	Baked->PlayLength = Clip.PlayLength;
+	Baked->SampleInterval = Clip.PlayLength / (Clip.NumSamples - 1);
+	Baked->Prefix.SetNumUninitialized(Clip.NumSamples);
+	Baked->PrefixInverse.SetNumUninitialized(Clip.NumSamples);
+	for (uint32 i = 0; i < Clip.NumSamples; i++)
+	{
+		Baked->Prefix[i] = DecodeSample(Samples[i], Clip.TranslationScale);
+		Baked->PrefixInverse[i] = Baked->Prefix[i].Inverse();
+	}
+	return Baked;
+}
+
+SIZE_T FRMSRootMotionLibrary::GetClipDataSize(int32 ClipIndex) const
+{
+	if (ClipIndex < 0 || ClipIndex >= GetNumClips())
+	{
+		return 0;
+	}
+	const FClipEntry& Clip = Clips[ClipIndex];
+	return sizeof(FClipEntry) + Clip.NumSamples * sizeof(FSample) + Clip.NumWindows * sizeof(FWindowEntry)
+		+ Clip.NameLength;
+}
+
+bool FRMSRootMotionLibraryBuilder::AddClip(UAnimSequenceBase* Animation)
+{
+	const FRMSBakedRootMotionPtr Baked = FRMSBakedRootMotion::Bake(Animation, SampleRate, false);
+	if (!Baked.IsValid() || !Baked->IsValid())
+	{
+		return false;
+	}
+	FClip& Clip = Clips.AddDefaulted_GetRef();
+	Clip.Name = Animation->GetPathName();
+	Clip.PlayLength = Baked->PlayLength;
+
+	//Prefix已经是相对动画起点的, 用最大位移决定定点数精度
+	float MaxAbs = 0.f;
+	for (const FTransform& T : Baked->Prefix)
+	{
+		MaxAbs = FMath::Max(MaxAbs, T.GetLocation().GetAbsMax());
+	}
+	Clip.TranslationScale = FMath::Max(MaxAbs / MAX_int16, UE_KINDA_SMALL_NUMBER);
+	auto Quantize_Lambda = [](double Value)
+	{
+		return static_cast<int16>(FMath::Clamp<int32>(FMath::RoundToInt(Value), -MAX_int16, MAX_int16));
+	};
+	Clip.Samples.Reserve(Baked->Prefix.Num());
+	for (const FTransform& T : Baked->Prefix)
+	{
+		const FVector Quantized = T.GetLocation() / Clip.TranslationScale;
+		FSample& Sample = Clip.Samples.AddDefaulted_GetRef();
+		Sample.X = Quantize_Lambda(Quantized.X);
+		Sample.Y = Quantize_Lambda(Quantized.Y);
+		Sample.Z = Quantize_Lambda(Quantized.Z);
+		Sample.Yaw = FRotator::CompressAxisToShort(T.Rotator().Yaw);
+	}
+
+	TArray<FRMSWindowData> Windows;
+	if (UAnimSequence* Sequence = Cast<UAnimSequence>(Animation))
+	{
+		URMSLibrary::GetRootMotionSourceWindows(Sequence, Windows);
+	}
+	for (const FRMSWindowData& Window : Windows)
+	{
+		FRMSRootMotionLibraryWindow& Out = Clip.Windows.AddDefaulted_GetRef();
+		Out.RootMotionSourceTarget = Window.IsValid() ? Window.AnimNotify->RootMotionSourceTarget : NAME_None;
+		Out.StartTime = Window.StartTime;
+		Out.EndTime = Window.EndTime;
+	}
+
+	const SIZE_T ClipBytes = sizeof(FClipEntry) + Clip.Samples.Num() * sizeof(FSample)
+		+ Clip.Windows.Num() * sizeof(FWindowEntry) + FTCHARToUTF8(*Clip.Name).Length();
+	UE_LOG(LogTemp, Log, TEXT("RMS root motion library: %s, %d samples, %llu bytes (source animation %lld bytes)"),
+	       *Clip.Name, Clip.Samples.Num(), static_cast<uint64>(ClipBytes),
+	       static_cast<int64>(Animation->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal)));
+	return true;
+}
+
+void FRMSRootMotionLibraryBuilder::Write(TArray<uint8>& OutData) const
+{
+	TArray<uint8> StringTable;
+	auto AddString_Lambda = [&StringTable](const FString& Str, uint32& OutOffset, uint32& OutLength)
+	{
+		const FTCHARToUTF8 Utf8(*Str);
+		OutOffset = StringTable.Num();
+		OutLength = Utf8.Length();
+		StringTable.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	};
+
+	TArray<FClipEntry> Entries;
+	Entries.SetNumZeroed(Clips.Num());
+	TArray<FSample> AllSamples;
+	TArray<FWindowEntry> AllWindows;
+	for (int32 i = 0; i < Clips.Num(); i++)
+	{
+		const FClip& Clip = Clips[i];
+		FClipEntry& Entry = Entries[i];
+		AddString_Lambda(Clip.Name, Entry.NameOffset, Entry.NameLength);
+		Entry.PlayLength = Clip.PlayLength;
+		Entry.TranslationScale = Clip.TranslationScale;
+		Entry.NumSamples = Clip.Samples.Num();
+		//先记录相对位置, 最后再加上各个区块的起点
+		Entry.SampleOffset = AllSamples.Num() * sizeof(FSample);
+		AllSamples.Append(Clip.Samples);
+		Entry.NumWindows = Clip.Windows.Num();
+		Entry.WindowOffset = AllWindows.Num() * sizeof(FWindowEntry);
+		for (const FRMSRootMotionLibraryWindow& Window : Clip.Windows)
+		{
+			FWindowEntry& WindowEntry = AllWindows.AddZeroed_GetRef();
+			AddString_Lambda(Window.RootMotionSourceTarget.ToString(), WindowEntry.NameOffset, WindowEntry.NameLength);
+			WindowEntry.StartTime = Window.StartTime;
+			WindowEntry.EndTime = Window.EndTime;
+		}
+	}
+
+	const uint32 ClipTableSize = Entries.Num() * sizeof(FClipEntry);
+	const uint32 SampleStart = sizeof(FHeader) + ClipTableSize;
+	const uint32 WindowStart = SampleStart + AllSamples.Num() * sizeof(FSample);
+	const uint32 StringStart = WindowStart + AllWindows.Num() * sizeof(FWindowEntry);
+	for (FClipEntry& Entry : Entries)
+	{
+		Entry.SampleOffset += SampleStart;
+		Entry.WindowOffset += WindowStart;
+	}
+
+	FHeader Header;
+	Header.Magic = RMSRootMotionLibrary::Magic;
+	Header.Version = RMSRootMotionLibrary::Version;
+	Header.SampleRate = SampleRate;
+	Header.NumClips = Entries.Num();
+	Header.StringTableOffset = StringStart;
+	Header.StringTableSize = StringTable.Num();
+
+	OutData.Reset(StringStart + StringTable.Num());
+	OutData.Append(reinterpret_cast<const uint8*>(&Header), sizeof(FHeader));
+	OutData.Append(reinterpret_cast<const uint8*>(Entries.GetData()), ClipTableSize);
+	OutData.Append(reinterpret_cast<const uint8*>(AllSamples.GetData()), AllSamples.Num() * sizeof(FSample));
+	OutData.Append(reinterpret_cast<const uint8*>(AllWindows.GetData()), AllWindows.Num() * sizeof(FWindowEntry));
+	OutData.Append(StringTable);
+}
+
+bool FRMSRootMotionLibraryBuilder::SaveToFile(const FString& Filename) const
+{
+	TArray<uint8> OutData;
+	Write(OutData);
+	return FFileHelper::SaveArrayToFile(OutData, *Filename);
+}
@@ -0,0 +1,42 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+
+#include "RMSSourceAllocator.h"
+#include "RMSTypes.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Source Slab Allocations"), STAT_RMS_SourceSlabAllocations, STATGROUP_RMS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Source Heap Allocations"), STAT_RMS_SourceHeapAllocations, STATGROUP_RMS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Source Slab Frees"), STAT_RMS_SourceSlabFrees, STATGROUP_RMS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Source Heap Frees"), STAT_RMS_SourceHeapFrees, STATGROUP_RMS);
+//只统计分块里的, 引擎反序列化创建的RMS不经过分配器
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Live Slab Sources"), STAT_RMS_LiveSources, STATGROUP_RMS);
+
+namespace RMSSourceAllocator
+{
+void TrackAllocate(bool bFromSlab)
+{
+	if (bFromSlab)
+	{
+		INC_DWORD_STAT(STAT_RMS_SourceSlabAllocations);
+		INC_DWORD_STAT(STAT_RMS_LiveSources);
+	}
+	else
+	{
+		INC_DWORD_STAT(STAT_RMS_SourceHeapAllocations);
+	}
+}
+
+void TrackFree(bool bFromSlab)
+{
+	if (bFromSlab)
+	{
+		INC_DWORD_STAT(STAT_RMS_SourceSlabFrees);
+		DEC_DWORD_STAT(STAT_RMS_LiveSources);
+	}
+	else
+	{
+		INC_DWORD_STAT(STAT_RMS_SourceHeapFrees);
+	}
+}
+}
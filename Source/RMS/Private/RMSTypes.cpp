@@ -3,9 +3,106 @@
 
 
 #include "RMSTypes.h"
+#include "Curves/CurveVector.h"
 
 
 namespace RMS
 {
+#if RMS_DEBUG
 TAutoConsoleVariable<int32> CVarRMS_Debug(TEXT("b.RMS.Debug"), 0, TEXT("0: Disable 1: Enable "), ECVF_Cheat);
-}
\ No newline at end of file
+TAutoConsoleVariable<int32> CVarRMS_ValidateWarpKernel(TEXT("b.RMS.ValidateWarpKernel"), 0,
+                                                       TEXT("Compare the AnimWarping warp kernel with the matrix implementation every tick. 0: Disable 1: Enable"),
+                                                       ECVF_Cheat);
+#endif
+TAutoConsoleVariable<float> CVarRMS_RootMotionBakeRate(TEXT("b.RMS.RootMotionBakeRate"), 60.f,
+                                                       TEXT("Sample rate (Hz) used to bake animation root motion for AnimWarping. 0: Disable, always extract from the animation"),
+                                                       ECVF_Default);
+TAutoConsoleVariable<int32> CVarRMS_CurveLUTResolution(TEXT("b.RMS.CurveLUTResolution"), 0,
+                                                       TEXT("Number of samples used to bake RMS curves into lookup tables when a source is applied. 0: Disable, always evaluate the curve"),
+                                                       ECVF_Default);
+TAutoConsoleVariable<float> CVarRMS_CurveLUTTolerance(TEXT("b.RMS.CurveLUTTolerance"), 0.01f,
+                                                      TEXT("Max error of a curve lookup table relative to the curve's value range, tables above it are discarded"),
+                                                      ECVF_Default);
+TAutoConsoleVariable<int32> CVarRMS_CurvePoolMaxSize(TEXT("b.RMS.CurvePoolMaxSize"), 64,
+                                                     TEXT("Max number of idle curves kept by each world's URMSCurvePool"),
+                                                     ECVF_Default);
+TAutoConsoleVariable<float> CVarRMS_CurvePoolRecycleDelay(TEXT("b.RMS.CurvePoolRecycleDelay"), 2.f,
+                                                         TEXT("Seconds a returned curve waits before URMSCurvePool clears and leases it again, must outlive saved moves and corrections that may still replay the source"),
+                                                         ECVF_Default);
+TAutoConsoleVariable<int32> CVarRMS_NetCurveSamples(TEXT("b.RMS.NetCurveSamples"), 33,
+                                                    TEXT("Number of samples used to replicate runtime created path offset curves that clients can not load"),
+                                                    ECVF_Default);
+TAutoConsoleVariable<int32> CVarRMS_PathCurveMaxSamples(TEXT("b.RMS.PathCurveMaxSamples"), 65,
+                                                        TEXT("Max number of samples kept when a generated path offset is simplified at apply time"),
+                                                        ECVF_Default);
+TAutoConsoleVariable<float> CVarRMS_PathCurveTolerance(TEXT("b.RMS.PathCurveTolerance"), 0.5f,
+                                                       TEXT("Max error (cm) allowed when a generated path offset is simplified at apply time"),
+                                                       ECVF_Default);
+}
+
+FRMSPathCurve FRMSPathCurve::Sample(const FRichCurve& CurveX, const FRichCurve& CurveY, const FRichCurve& CurveZ,
+                                    int32 NumSamples)
+{
+	FRMSPathCurve Out;
+	if (CurveX.GetNumKeys() + CurveY.GetNumKeys() + CurveZ.GetNumKeys() == 0)
+	{
+		return Out;
+	}
+	//与UCurveBase::GetTimeRange相同, 没有Key的曲线按[0, 0]算, 保证和原来的UCurveVector取值一致
+	float MinTime = TNumericLimits<float>::Max();
+	float MaxTime = TNumericLimits<float>::Lowest();
+	for (const FRichCurve* Curve : {&CurveX, &CurveY, &CurveZ})
+	{
+		float CurveMin, CurveMax;
+		Curve->GetTimeRange(CurveMin, CurveMax);
+		MinTime = FMath::Min(MinTime, CurveMin);
+		MaxTime = FMath::Max(MaxTime, CurveMax);
+	}
+	NumSamples = FMath::Max(NumSamples, 2);
+	Out.Samples.SetNumUninitialized(NumSamples);
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		const float Time = FMath::Lerp(MinTime, MaxTime, static_cast<float>(i) / (NumSamples - 1));
+		Out.Samples[i] = FVector3f(CurveX.Eval(Time), CurveY.Eval(Time), CurveZ.Eval(Time));
+	}
+	return Out;
+}
+
+FRMSPathCurve FRMSPathCurve::Sample(const UCurveVector& Curve, int32 NumSamples)
+{
+	return Sample(Curve.FloatCurves[0], Curve.FloatCurves[1], Curve.FloatCurves[2], NumSamples);
+}
+
+FRMSPathCurve FRMSPathCurve::Simplify(int32 MaxSamples, float Tolerance) const
+{
+	MaxSamples = FMath::Max(MaxSamples, 2);
+	FRMSPathCurve Out;
+	//每次分段数加倍, 通常几次就能满足误差
+	for (int32 NumSegments = 1;; NumSegments *= 2)
+	{
+		const int32 NumSamples = FMath::Min(NumSegments + 1, MaxSamples);
+		if (NumSamples >= Samples.Num())
+		{
+			return *this;
+		}
+		Out.Samples.SetNumUninitialized(NumSamples);
+		for (int32 i = 0; i < NumSamples; i++)
+		{
+			Out.Samples[i] = FVector3f(Evaluate(static_cast<float>(i) / (NumSamples - 1)));
+		}
+		if (NumSamples == MaxSamples)
+		{
+			return Out;
+		}
+		float MaxError = 0.f;
+		for (int32 i = 0; i < Samples.Num() && MaxError <= Tolerance; i++)
+		{
+			const FVector3f Simplified(Out.Evaluate(static_cast<float>(i) / (Samples.Num() - 1)));
+			MaxError = FMath::Max(MaxError, (Simplified - Samples[i]).GetAbsMax());
+		}
+		if (MaxError <= Tolerance)
+		{
+			return Out;
+		}
+	}
+}
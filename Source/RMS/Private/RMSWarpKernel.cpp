@@ -0,0 +1,169 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+
+#include "RMSWarpKernel.h"
+
+#include "RMSTypes.h"
+
+void FRMSWarpKernel::WarpTranslations(TConstArrayView<FVector> Translations, TConstArrayView<FVector> CurrentToRoot,
+                                      TConstArrayView<FVector> CurrentToWorld, TArrayView<FVector> OutTranslations)
+{
+	const int32 Num = Translations.Num();
+	check(CurrentToRoot.Num() == Num && CurrentToWorld.Num() == Num && OutTranslations.Num() == Num);
+	for (int32 i = 0; i < Num; i++)
+	{
+		const VectorRegister T = VectorLoadFloat3_W0(&Translations[i].X);
+		const VectorRegister C = VectorLoadFloat3_W0(&CurrentToRoot[i].X);
+		const VectorRegister W = VectorLoadFloat3_W0(&CurrentToWorld[i].X);
+		VectorStoreFloat3(WarpTranslation(T, C, W), &OutTranslations[i].X);
+	}
+}
+
+#if RMS_DEBUG
+FVector FRMSWarpKernel::WarpTranslation_Reference(const FVector& Translation, const FVector& CurrentToRootOffset,
+                                                  const FVector& CurrentToWorldOffset, const FQuat& CurrentRotation)
+{
+	FVector ToRootNormalized = CurrentToRootOffset.GetSafeNormal();
+	float BestMatchDot = FMath::Abs(FVector::DotProduct(ToRootNormalized, CurrentRotation.GetAxisX()));
+	FMatrix ToRootSyncSpace = FRotationMatrix::MakeFromXZ(ToRootNormalized, CurrentRotation.GetAxisZ());
+
+	float ZDot = FMath::Abs(FVector::DotProduct(ToRootNormalized, CurrentRotation.GetAxisZ()));
+	if (ZDot > BestMatchDot)
+	{
+		ToRootSyncSpace = FRotationMatrix::MakeFromXZ(ToRootNormalized, CurrentRotation.GetAxisX());
+		BestMatchDot = ZDot;
+	}
+
+	float YDot = FMath::Abs(FVector::DotProduct(ToRootNormalized, CurrentRotation.GetAxisY()));
+	if (YDot > BestMatchDot)
+	{
+		ToRootSyncSpace = FRotationMatrix::MakeFromXZ(ToRootNormalized, CurrentRotation.GetAxisZ());
+	}
+
+	const FVector RootMotionInSyncSpace = ToRootSyncSpace.InverseTransformVector(Translation);
+	const FVector CurrentToWorldSync = ToRootSyncSpace.InverseTransformVector(CurrentToWorldOffset);
+	const FVector CurrentToRootMotionSync = ToRootSyncSpace.InverseTransformVector(CurrentToRootOffset);
+
+	FVector CurrentToWorldSyncNorm = CurrentToWorldSync;
+	CurrentToWorldSyncNorm.Normalize();
+
+	FVector CurrentToRootMotionSyncNorm = CurrentToRootMotionSync;
+	CurrentToRootMotionSyncNorm.Normalize();
+
+	FVector FlatToWorld = FVector(CurrentToWorldSyncNorm.X, CurrentToWorldSyncNorm.Y, 0.0f);
+	FlatToWorld.Normalize();
+	FVector FlatToRoot = FVector(CurrentToRootMotionSyncNorm.X, CurrentToRootMotionSyncNorm.Y, 0.0f);
+	FlatToRoot.Normalize();
+	float AngleAboutZ = FMath::Acos(FVector::DotProduct(FlatToWorld, FlatToRoot));
+	float AngleAboutZNorm = FMath::DegreesToRadians(FRotator::NormalizeAxis(FMath::RadiansToDegrees(AngleAboutZ)));
+	if (FlatToWorld.Y < 0.0f)
+	{
+		AngleAboutZNorm *= -1.0f;
+	}
+
+	FVector ToWorldNoY = FVector(CurrentToWorldSyncNorm.X, 0.0f, CurrentToWorldSyncNorm.Z);
+	ToWorldNoY.Normalize();
+	FVector ToRootNoY = FVector(CurrentToRootMotionSyncNorm.X, 0.0f, CurrentToRootMotionSyncNorm.Z);
+	ToRootNoY.Normalize();
+	const float AngleAboutY = FMath::Acos(FVector::DotProduct(ToWorldNoY, ToRootNoY));
+	float AngleAboutYNorm = FMath::DegreesToRadians(FRotator::NormalizeAxis(FMath::RadiansToDegrees(AngleAboutY)));
+	if (ToWorldNoY.Z < 0.0f)
+	{
+		AngleAboutYNorm *= -1.0f;
+	}
+
+	FVector SkewedRootMotion = FVector::ZeroVector;
+	float ProjectedScale = FVector::DotProduct(CurrentToWorldSync, CurrentToRootMotionSyncNorm) /
+		CurrentToRootMotionSync.Size();
+	if (ProjectedScale != 0.0f)
+	{
+		FMatrix ScaleMatrix;
+		ScaleMatrix.SetIdentity();
+		ScaleMatrix.SetAxis(0, FVector(ProjectedScale, 0.0f, 0.0f));
+		ScaleMatrix.SetAxis(1, FVector(0.0f, 1.0f, 0.0f));
+		ScaleMatrix.SetAxis(2, FVector(0.0f, 0.0f, 1.0f));
+
+		FMatrix ShearXAlongYMatrix;
+		ShearXAlongYMatrix.SetIdentity();
+		ShearXAlongYMatrix.SetAxis(0, FVector(1.0f, FMath::Tan(AngleAboutZNorm), 0.0f));
+		ShearXAlongYMatrix.SetAxis(1, FVector(0.0f, 1.0f, 0.0f));
+		ShearXAlongYMatrix.SetAxis(2, FVector(0.0f, 0.0f, 1.0f));
+
+		FMatrix ShearXAlongZMatrix;
+		ShearXAlongZMatrix.SetIdentity();
+		ShearXAlongZMatrix.SetAxis(0, FVector(1.0f, 0.0f, FMath::Tan(AngleAboutYNorm)));
+		ShearXAlongZMatrix.SetAxis(1, FVector(0.0f, 1.0f, 0.0f));
+		ShearXAlongZMatrix.SetAxis(2, FVector(0.0f, 0.0f, 1.0f));
+
+		FMatrix ScaledSkewMatrix = ScaleMatrix * ShearXAlongYMatrix * ShearXAlongZMatrix;
+		SkewedRootMotion = ScaledSkewMatrix.TransformVector(RootMotionInSyncSpace);
+	}
+	else if (!CurrentToRootMotionSync.IsZero() && !CurrentToWorldSync.IsZero() && !RootMotionInSyncSpace.IsZero())
+	{
+		const float Scale = CurrentToWorldSync.Size() / CurrentToRootMotionSync.Size();
+		const float StepTowardTarget = RootMotionInSyncSpace.ProjectOnTo(RootMotionInSyncSpace).Size();
+		SkewedRootMotion = CurrentToWorldSyncNorm * (Scale * StepTowardTarget);
+	}
+
+	return ToRootSyncSpace.TransformVector(SkewedRootMotion);
+}
+
+namespace
+{
+//随机生成输入, 对比两种实现的误差和耗时
+void BenchmarkWarpKernel(const TArray<FString>& Args)
+{
+	const int32 Num = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100000;
+	FRandomStream Stream(Num);
+	TArray<FVector> Translations, ToRoot, ToWorld, Results;
+	TArray<FQuat> Rotations;
+	Translations.SetNumUninitialized(Num);
+	ToRoot.SetNumUninitialized(Num);
+	ToWorld.SetNumUninitialized(Num);
+	Results.SetNumUninitialized(Num);
+	Rotations.SetNumUninitialized(Num);
+	for (int32 i = 0; i < Num; i++)
+	{
+		//动画方向和目标方向都在角色前方半球内, 与实际用法一致
+		const FQuat Rotation = FRotator(0.f, Stream.FRandRange(-180.f, 180.f), 0.f).Quaternion();
+		const FVector Root = Rotation.RotateVector(FVector(Stream.FRandRange(50.f, 500.f), Stream.FRandRange(-200.f, 200.f),
+		                                                   Stream.FRandRange(-50.f, 50.f)));
+		const FVector World = Rotation.RotateVector(FVector(Stream.FRandRange(50.f, 500.f), Stream.FRandRange(-200.f, 200.f),
+		                                                    Stream.FRandRange(-50.f, 50.f)));
+		Rotations[i] = Rotation;
+		ToRoot[i] = Root;
+		ToWorld[i] = World;
+		Translations[i] = Root * Stream.FRandRange(0.001f, 0.1f) + Stream.GetUnitVector() * Stream.FRandRange(0.f, 2.f);
+	}
+
+	double MaxError = 0.0;
+	double ReferenceSum = 0.0;
+	for (int32 i = 0; i < Num; i++)
+	{
+		const FVector Reference = FRMSWarpKernel::WarpTranslation_Reference(Translations[i], ToRoot[i], ToWorld[i],
+		                                                                    Rotations[i]);
+		ReferenceSum += Reference.X;
+		MaxError = FMath::Max(MaxError, (Reference - FRMSWarpKernel::WarpTranslation(Translations[i], ToRoot[i], ToWorld[i])).
+		                      GetAbsMax());
+	}
+	double Start = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Num; i++)
+	{
+		ReferenceSum += FRMSWarpKernel::WarpTranslation_Reference(Translations[i], ToRoot[i], ToWorld[i], Rotations[i]).X;
+	}
+	const double ReferenceTime = FPlatformTime::Seconds() - Start;
+
+	Start = FPlatformTime::Seconds();
+	FRMSWarpKernel::WarpTranslations(Translations, ToRoot, ToWorld, Results);
+	const double KernelTime = FPlatformTime::Seconds() - Start;
+
+	UE_LOG(LogTemp, Log, TEXT("RMS warp kernel: %d samples, reference %.3f ms, kernel %.3f ms, max error %f cm (%f)"),
+	       Num, ReferenceTime * 1000.0, KernelTime * 1000.0, MaxError, ReferenceSum);
+}
+
+FAutoConsoleCommand BenchmarkWarpKernelCommand(TEXT("RMS.BenchmarkWarpKernel"),
+                                               TEXT("RMS.BenchmarkWarpKernel [Num]: compare the AnimWarping warp kernel with the matrix implementation"),
+                                               FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkWarpKernel));
+}
+#endif
@@ -0,0 +1,58 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RMSTypes.h"
+#include "Engine/AssetUserData.h"
+#include "RMSAnimationAssetUserData.generated.h"
+
+class UAnimSequenceBase;
+
+/**
+ * 挂在动画资源上的RMS预计算数据, 保存(包括Cook)时重新生成
+ * 运行时烘焙缓存和窗口查询优先使用这里的数据, 不再采样动画
+ * 通过 URMSLibrary::BakeAnimationRootMotionData 或者控制台命令 RMS.BakeAnimationData 添加到动画上
+ */
+UCLASS()
+class RMS_API URMSAnimationAssetUserData : public UAssetUserData
+{
+	GENERATED_BODY()
+public:
+	//烘焙使用的采样率(Hz), 与运行时的 b.RMS.RootMotionBakeRate 无关
+	UPROPERTY(EditAnywhere, Category = "RMS", meta = (ClampMin = "1", UIMin = "1"))
+	float BakeSampleRate = 60.f;
+
+	//实际采样率, 均分整个动画后会略高于BakeSampleRate
+	UPROPERTY(VisibleAnywhere, Category = "RMS")
+	float SampleRate = 0.f;
+
+	UPROPERTY(VisibleAnywhere, Category = "RMS")
+	float PlayLength = 0.f;
+
+	//均分动画后每个采样点从0开始的累计RootMotion, 第一个是Identity
+	UPROPERTY(VisibleAnywhere, Category = "RMS")
+	TArray<FTransform> RootMotionPrefix;
+
+	//UAnimNotifyState_RMS_Warping窗口, 与动画Notifies的顺序相同
+	UPROPERTY(VisibleAnywhere, Category = "RMS")
+	TArray<FRMSWindowData> Windows;
+
+	FORCEINLINE bool HasRootMotion() const
+	{
+		return RootMotionPrefix.Num() > 1 && SampleRate > 0.f && PlayLength > 0.f;
+	}
+
+	static URMSAnimationAssetUserData* Get(const UAnimSequenceBase* Animation);
+
+#if WITH_EDITOR
+	//创建或者更新动画上的数据, SampleRate <= 0 时保留已有的BakeSampleRate
+	static URMSAnimationAssetUserData* BakeToAsset(UAnimSequenceBase* Animation, float SampleRate = 0.f);
+
+	void Rebuild(UAnimSequenceBase* Animation);
+
+	virtual void PreSave(FObjectPreSaveContext SaveContext) override;
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+};
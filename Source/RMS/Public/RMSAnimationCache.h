@@ -0,0 +1,129 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RMSTypes.h"
+#include "HAL/CriticalSection.h"
+#include "UObject/ObjectKey.h"
+
+class UAnimSequenceBase;
+
+/**
+ * 按固定采样率烘焙的动画RootMotion轨道, 创建后只读, 所有RMS共享
+ * Prefix[i] 是 [0, i * SampleInterval] 的累计RootMotion, PrefixInverse[i] 是它的逆
+ * 任意区间 [A, B] 的RootMotion = P(B) * P(A)^-1, 与动画长度无关
+ * 采样点之间先插值P再求逆, PrefixInverse只在正好落在采样点上时使用
+ */
+struct RMS_API FRMSBakedRootMotion
+{
+	float SampleRate = 0.f;
+	float SampleInterval = 0.f;
+	float PlayLength = 0.f;
+	TArray<FTransform> Prefix;
+	TArray<FTransform> PrefixInverse;
+	//来自预计算数据(URMSAnimationAssetUserData或者RootMotion库), 不受采样率设置影响
+	bool bFromAssetData = false;
+
+	FORCEINLINE bool IsValid() const
+	{
+		return Prefix.Num() > 1 && Prefix.Num() == PrefixInverse.Num() && SampleInterval > 0.f;
+	}
+
+	//与URMSLibrary::ExtractRootMotion相同的语义, 采样之间做插值
+	FTransform ExtractRootMotion(float StartTime, float EndTime) const;
+
+	//从0到Time的累计RootMotion
+	FTransform GetRootMotionAtTime(float Time) const;
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return sizeof(FRMSBakedRootMotion) + Prefix.GetAllocatedSize() + PrefixInverse.GetAllocatedSize();
+	}
+
+	/** bUseAssetData为true时优先使用动画上预计算的数据, 此时忽略SampleRate */
+	static TSharedPtr<const FRMSBakedRootMotion, ESPMode::ThreadSafe> Bake(UAnimSequenceBase* Animation, float SampleRate,
+	                                                                       bool bUseAssetData = true);
+
+private:
+	FORCEINLINE void GetSamplePosition(float Time, int32& OutIndex, float& OutAlpha) const
+	{
+		const float Pos = FMath::Clamp(Time, 0.f, PlayLength) / SampleInterval;
+		OutIndex = FMath::Min(FMath::FloorToInt(Pos), Prefix.Num() - 2);
+		OutAlpha = FMath::Clamp(Pos - OutIndex, 0.f, 1.f);
+	}
+
+	static FORCEINLINE FTransform BlendSamples(const TArray<FTransform>& Samples, int32 Index, float Alpha)
+	{
+		FTransform Out;
+		Out.Blend(Samples[Index], Samples[Index + 1], Alpha);
+		return Out;
+	}
+};
+
+typedef TSharedPtr<const FRMSBakedRootMotion, ESPMode::ThreadSafe> FRMSBakedRootMotionPtr;
+
+/**
+ * 动画上UAnimNotifyState_RMS_Warping窗口的索引, 创建后只读
+ */
+struct RMS_API FRMSWindowIndex
+{
+	//与动画Notifies的顺序相同
+	TArray<FRMSWindowData> Windows;
+	//同名的窗口只记录Notifies里的第一个
+	TMap<FName, int32> IndexByName;
+
+	const FRMSWindowData* FindByName(FName InstanceName) const
+	{
+		const int32* Found = IndexByName.Find(InstanceName);
+		return Found ? &Windows[*Found] : nullptr;
+	}
+
+	static TSharedPtr<const FRMSWindowIndex, ESPMode::ThreadSafe> Build(const UAnimSequenceBase* Animation);
+};
+
+typedef TSharedPtr<const FRMSWindowIndex, ESPMode::ThreadSafe> FRMSWindowIndexPtr;
+
+/**
+ * 进程级的动画数据缓存, 每个动画只烘焙一次
+ */
+class RMS_API FRMSAnimationCache
+{
+public:
+	static FRMSAnimationCache& Get();
+
+	void Startup();
+	void Shutdown();
+
+	/** 优先使用动画上的URMSAnimationAssetUserData, 否则按 b.RMS.RootMotionBakeRate 烘焙, 为0时返回空 */
+	FRMSBakedRootMotionPtr FindOrBakeRootMotion(UAnimSequenceBase* Animation);
+
+	/** 动画的窗口索引, 动画资源改变时失效 */
+	FRMSWindowIndexPtr FindOrBuildWindowIndex(const UAnimSequenceBase* Animation);
+
+	/** 优先使用烘焙数据, 没有的话回退到URMSLibrary::ExtractRootMotion */
+	static FTransform ExtractRootMotion(UAnimSequenceBase* Animation, const FRMSBakedRootMotion* Baked, float StartTime,
+	                                    float EndTime);
+
+	void Invalidate(const UObject* Animation);
+	void Empty();
+
+	/** 注册预先生成的RootMotion库, 烘焙前先按动画PathName查找库里的数据 */
+	void AddLibrary(const TSharedPtr<class FRMSRootMotionLibrary, ESPMode::ThreadSafe>& Library);
+	void RemoveLibrary(const TSharedPtr<class FRMSRootMotionLibrary, ESPMode::ThreadSafe>& Library);
+
+private:
+	void OnPostGarbageCollect();
+#if WITH_EDITOR
+	void OnObjectPropertyChanged(UObject* Object, struct FPropertyChangedEvent& Event);
+#endif
+
+	FRWLock Lock;
+	TMap<FObjectKey, FRMSBakedRootMotionPtr> BakedRootMotions;
+	TMap<FObjectKey, FRMSWindowIndexPtr> WindowIndices;
+	TArray<TSharedPtr<class FRMSRootMotionLibrary, ESPMode::ThreadSafe>> Libraries;
+
+	FDelegateHandle PostGarbageCollectHandle;
+	FDelegateHandle PropertyChangedHandle;
+};
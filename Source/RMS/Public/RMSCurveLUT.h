@@ -0,0 +1,86 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UCurveFloat;
+class UCurveVector;
+
+/**
+ * 曲线按固定分辨率预采样的查找表, 创建后只读, 通过TSharedPtr在RMS之间共享
+ * 采样范围是曲线的时间范围, 范围外按常量外插, 所以只接受常量外插的曲线
+ * MaxError是每段中点处与原曲线的最大误差
+ */
+struct RMS_API FRMSCurveLUT
+{
+	float MinTime = 0.f;
+	float MaxTime = 0.f;
+	float MaxError = 0.f;
+	TArray<float> Values;
+
+	/** 与URMSLibrary::EvaluateFloatCurveAtFraction相同, Fraction映射到曲线时间范围 */
+	FORCEINLINE float EvaluateAtFraction(float Fraction) const
+	{
+		const float Pos = FMath::Clamp(Fraction, 0.f, 1.f) * (Values.Num() - 1);
+		const int32 Index = FMath::Min(FMath::FloorToInt(Pos), Values.Num() - 2);
+		return FMath::Lerp(Values[Index], Values[Index + 1], Pos - Index);
+	}
+
+	/** 与UCurveFloat::GetFloatValue相同 */
+	FORCEINLINE float Evaluate(float Time) const
+	{
+		return EvaluateAtFraction(MaxTime > MinTime ? (Time - MinTime) / (MaxTime - MinTime) : 0.f);
+	}
+
+	/** 分辨率由b.RMS.CurveLUTResolution决定, 为0, 曲线不支持或者误差超出b.RMS.CurveLUTTolerance时返回空 */
+	static TSharedPtr<const FRMSCurveLUT, ESPMode::ThreadSafe> Build(const UCurveFloat* Curve);
+};
+
+struct RMS_API FRMSVectorCurveLUT
+{
+	float MinTime = 0.f;
+	float MaxTime = 0.f;
+	float MaxError = 0.f;
+	//XYZ, W只用于对齐
+	TArray<FVector4f> Values;
+
+	/** 与URMSLibrary::EvaluateVectorCurveAtFraction相同, 三个轴一次插值 */
+	FORCEINLINE FVector EvaluateAtFraction(float Fraction) const
+	{
+		const float Pos = FMath::Clamp(Fraction, 0.f, 1.f) * (Values.Num() - 1);
+		const int32 Index = FMath::Min(FMath::FloorToInt(Pos), Values.Num() - 2);
+		const VectorRegister4Float A = VectorLoad(&Values[Index].X);
+		const VectorRegister4Float B = VectorLoad(&Values[Index + 1].X);
+		const VectorRegister4Float Result = VectorMultiplyAdd(VectorSubtract(B, A), VectorSetFloat1(Pos - Index), A);
+		FVector4f Out;
+		VectorStore(Result, &Out.X);
+		return FVector(Out.X, Out.Y, Out.Z);
+	}
+
+	static TSharedPtr<const FRMSVectorCurveLUT, ESPMode::ThreadSafe> Build(const UCurveVector* Curve);
+};
+
+typedef TSharedPtr<const FRMSCurveLUT, ESPMode::ThreadSafe> FRMSCurveLUTPtr;
+typedef TSharedPtr<const FRMSVectorCurveLUT, ESPMode::ThreadSafe> FRMSVectorCurveLUTPtr;
+
+/**
+ * 一个RMS用到的曲线查找表, 应用RMS时创建, 没有查找表的曲线直接求值
+ */
+struct RMS_API FRMSCurveLUTSet
+{
+	FRMSCurveLUTPtr TimeMapping;
+	FRMSVectorCurveLUTPtr PathOffset;
+	FRMSCurveLUTPtr Rotation;
+
+	void Build(const UCurveFloat* TimeMappingCurve, const UCurveVector* PathOffsetCurve,
+	           const UCurveFloat* RotationCurve);
+
+	/** TimeMappingCurve为空时返回Fraction */
+	float MapTime(const UCurveFloat* TimeMappingCurve, float Fraction) const;
+	/** 朝向空间的偏移, PathOffsetCurve为空时返回0 */
+	FVector GetPathOffset(const UCurveVector* PathOffsetCurve, float Fraction) const;
+	/** 与URMSLibrary::ExtractRotation中的处理相同, 结果限制在0-1 */
+	float GetRotationFraction(const UCurveFloat* RotationCurve, float Fraction) const;
+};
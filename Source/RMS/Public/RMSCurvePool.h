@@ -0,0 +1,82 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "RMSCurvePool.generated.h"
+
+class UCurveVector;
+class UCharacterMovementComponent;
+
+/**
+ * 每个World一个的UCurveVector池, 给游戏里运行时生成偏移曲线的逻辑复用, 避免每次Apply都NewObject
+ * 插件自己的Apply函数已经把路径保存为FRMSPathCurve, 不再创建曲线, 也不使用这个池
+ * 曲线可以手动归还, 也可以绑定到RMS上, RMS结束或者被移除后下一次租用时自动归还
+ * SavedMove和纠正时的Clone仍然持有曲线指针, 所以归还后要等 b.RMS.CurvePoolRecycleDelay 秒才会清空并再次租出
+ * 池里最多保留 b.RMS.CurvePoolMaxSize 条空闲曲线
+ */
+UCLASS()
+class RMS_API URMSCurvePool : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	static URMSCurvePool* Get(const UObject* WorldContextObject);
+
+	/** 租用一条没有Key的曲线, 池里没有空闲曲线时新建 */
+	UFUNCTION(BlueprintCallable, Category = "RMS|CurvePool")
+	UCurveVector* LeaseVectorCurve();
+
+	/** 归还曲线, 归还后不能再使用 */
+	UFUNCTION(BlueprintCallable, Category = "RMS|CurvePool")
+	void ReturnVectorCurve(UCurveVector* Curve);
+
+	/** 曲线跟随RMS的生命周期, SourceID是ApplyRootMotionSource的返回值 */
+	UFUNCTION(BlueprintCallable, Category = "RMS|CurvePool")
+	void ReturnVectorCurveOnSourceEnd(UCurveVector* Curve, UCharacterMovementComponent* MovementComponent,
+	                                  int32 SourceID);
+
+	/** Hits/Misses是World创建后租用的总次数, Leased包括已经归还但还在等待回收的曲线 */
+	UFUNCTION(BlueprintPure, Category = "RMS|CurvePool")
+	void GetPoolStats(int32& OutHits, int32& OutMisses, int32& OutFree, int32& OutLeased) const;
+
+	/** 归还所有绑定的RMS已经不存在的曲线 */
+	void CollectFinishedLeases();
+
+	virtual void Deinitialize() override;
+
+private:
+	//开始等待回收, 等待期间曲线保持原样
+	void Recycle(UCurveVector* Curve);
+	//清空等待时间已到的曲线并放回空闲列表
+	void RecycleCooledCurves();
+
+	struct FSourceLease
+	{
+		TWeakObjectPtr<UCharacterMovementComponent> MovementComponent;
+		uint16 SourceID = 0;
+		UCurveVector* Curve = nullptr;
+	};
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UCurveVector>> FreeCurves;
+
+	//租出去的曲线也由池持有, 归还前不会被GC
+	UPROPERTY(Transient)
+	TSet<TObjectPtr<UCurveVector>> LeasedCurves;
+
+	TArray<FSourceLease> SourceLeases;
+
+	struct FCoolingCurve
+	{
+		UCurveVector* Curve = nullptr;
+		double RecycleTime = 0.0;
+	};
+
+	//按RecycleTime从早到晚排列, 曲线仍然在LeasedCurves里
+	TArray<FCoolingCurve> CoolingCurves;
+
+	int32 NumHits = 0;
+	int32 NumMisses = 0;
+};
@@ -5,13 +5,81 @@
 
 #include "CoreMinimal.h"
 #include "RMSTypes.h"
+#include "RMSAnimationCache.h"
+#include "RMSCurveLUT.h"
+#include "RMSSourceAllocator.h"
 #include "GameFramework/RootMotionSource.h"
 #include "RMSGroupEx.generated.h"
 
+class USkeletalMeshComponent;
+
+/**
+ * 角色在当前移动Tick中的状态快照, 同一个角色上所有RMS共享, 每个RMS的PrepareRootMotion开始时取一次再传给内部函数
+ * 引擎逐个调用RMS的PrepareRootMotion, 签名固定没法直接传参数, 所以由FScope在移动Tick外层创建一次:
+ * 自定义的CMC可以在PerformMovement外面声明FScope, 期间Get直接返回这一份, 不再读取角色的任何状态
+ * 插件本身不创建FScope, 使用引擎自带的CMC时总是退回到按角色, GFrameCounter和角色Transform缓存, 同一帧内角色被移动后会重新获取
+ * 角色没有模型时MeshTransform为角色的Transform
+ */
+struct RMS_API FRMSCharacterFrameContext
+{
+	FVector ActorLocation = FVector::ZeroVector;
+	FQuat ActorQuat = FQuat::Identity;
+	FTransform MeshTransform = FTransform::Identity;
+	float HalfHeight = 0.f;
+	//脚底位置
+	FVector FootLocation = FVector::ZeroVector;
+
+	static const FRMSCharacterFrameContext& Get(const ACharacter& Character);
+
+	/** 在作用域内为Character固定一份Context, 可以嵌套, 只在创建它的线程生效 */
+	class RMS_API FScope : FNoncopyable
+	{
+	public:
+		explicit FScope(const ACharacter& Character);
+		~FScope();
+
+	private:
+		FRMSCharacterFrameContext Context;
+		FScope* Previous = nullptr;
+		friend struct FRMSCharacterFrameContext;
+	};
+
+private:
+	void Build(const ACharacter& InCharacter);
+
+	FObjectKey CharacterKey;
+	uint64 FrameCounter = 0;
+};
+
+/**
+ * PathMoveToForce应用后不再改变的数据, 创建后只读, 所有复制体共享
+ * CharacterMovementComponent为SavedMove和纠正Clone时只增加引用计数, 与路径长度无关
+ */
+struct RMS_API FRMSPathMoveToPayload
+{
+	TArray<FRMSPathMoveToData> Path;
+	//每一段的结束时间(累计), 与Path一一对应
+	TArray<float> SegmentEndTimes;
+	//与Path一一对应, 为空时直接求值曲线
+	TArray<FRMSCurveLUTSet> PathCurveLUTs;
+	//RMSNetQuantize::HashPath(Path), Matches里代替逐段比较
+	uint64 Fingerprint = 0;
+
+	/** 二分查找包含Time的段, 超出范围时返回INDEX_NONE */
+	int32 GetSegmentIndexByTime(float Time) const;
+
+	void AddReferencedObjects(FReferenceCollector& Collector) const;
+
+	static TSharedPtr<const FRMSPathMoveToPayload, ESPMode::ThreadSafe> Create(TArray<FRMSPathMoveToData> InPath);
+};
+
+typedef TSharedPtr<const FRMSPathMoveToPayload, ESPMode::ThreadSafe> FRMSPathMoveToPayloadPtr;
+
 USTRUCT()
 struct RMS_API FRootMotionSource_PathMoveToForce : public FRootMotionSource
 {
 	GENERATED_USTRUCT_BODY()
+	RMS_DECLARE_SOURCE_ALLOCATOR()
 	FRootMotionSource_PathMoveToForce();
 
 	virtual ~FRootMotionSource_PathMoveToForce()
@@ -22,19 +90,39 @@ struct RMS_API FRootMotionSource_PathMoveToForce : public FRootMotionSource
 	FVector StartLocation = FVector::ZeroVector;
 	UPROPERTY()
 	FRotator StartRotation = FRotator::ZeroRotator;
-	UPROPERTY()
-	TArray<FRMSPathMoveToData> Path;
-
 
-	FRMSPathMoveToData CurrData;
-	FRMSPathMoveToData LastData;
+	//当前段, 只向前移动
 	int32 Index = -1;
+	//当前段开始时的角色朝向
+	FRotator SegmentStartRotation = FRotator::ZeroRotator;
 
+	/** 设置路径, 同时创建段表和曲线查找表, 之后路径不能再修改 */
+	void SetPath(TArray<FRMSPathMoveToData> InPath);
+	const TArray<FRMSPathMoveToData>& GetPath() const;
 
-	FVector GetPathOffsetInWorldSpace(const float MoveFraction, FRMSPathMoveToData Data, FVector Start) const;
+	int32 GetSegmentIndexByTime(float Time) const
+	{
+		return Payload.IsValid() ? Payload->GetSegmentIndexByTime(Time) : INDEX_NONE;
+	}
+
+	FVector GetPathOffsetInWorldSpace(const float MoveFraction, const FRMSPathMoveToData& Data, const FVector& Start,
+	                                  const FRMSCurveLUTSet* CurveLUTs = nullptr) const;
+	const FRMSCurveLUTSet* GetCurveLUTs(int32 PathIndex) const
+	{
+		return Payload.IsValid() && Payload->PathCurveLUTs.IsValidIndex(PathIndex)
+			       ? &Payload->PathCurveLUTs[PathIndex]
+			       : nullptr;
+	}
 
 	bool GetPathDataByTime(float Time, FRMSPathMoveToData& OutCurrData, FRMSPathMoveToData& OutLastData) const;
 
+	/** 第SegmentIndex段在Time(整条路径的时间)时的位置, OutMoveFraction是经过TimeMapping后的段内比例 */
+	FVector GetSegmentLocation(int32 SegmentIndex, float Time, float& OutMoveFraction) const;
+
+	/** 按Times(与GetTime相同, 超出[0, Duration]时取端点)批量求值角色中心的位置, OutLocations与Times一一对应 */
+	bool SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+	                      TArrayView<FVector> OutLocations) const;
+
 	virtual bool UpdateStateFrom(const FRootMotionSource* SourceToTakeStateFrom, bool bMarkForSimulatedCatchup = false) override;
 
 	virtual void PrepareRootMotion(
@@ -50,9 +138,14 @@ struct RMS_API FRootMotionSource_PathMoveToForce : public FRootMotionSource
 	virtual bool Matches(const FRootMotionSource* Other) const override;
 
 	virtual bool MatchesAndHasSameState(const FRootMotionSource* Other) const override;
+	/** 可变状态的指纹, MatchesAndHasSameState里比较 */
+	uint64 GetStateFingerprint() const;
 	virtual UScriptStruct* GetScriptStruct() const override;
 	virtual FString ToSimpleString() const override;
 	virtual void AddReferencedObjects(class FReferenceCollector& Collector) override;
+
+protected:
+	FRMSPathMoveToPayloadPtr Payload;
 };
 
 template <>
@@ -70,6 +163,7 @@ USTRUCT()
 struct RMS_API FRootMotionSource_JumpForce_WithPoints : public FRootMotionSource
 {
 	GENERATED_USTRUCT_BODY()
+	RMS_DECLARE_SOURCE_ALLOCATOR()
 	FRootMotionSource_JumpForce_WithPoints();
 
 	virtual ~FRootMotionSource_JumpForce_WithPoints()
@@ -98,21 +192,31 @@ struct RMS_API FRootMotionSource_JumpForce_WithPoints : public FRootMotionSource
 	UPROPERTY()
 	TObjectPtr<UCurveFloat> TimeMappingCurve = nullptr;
 protected:
-	UPROPERTY()
-	TObjectPtr<UCurveVector> PathOffsetCurve = nullptr;
-
-
 	FVector SavedHalfwayLocation;
 	float SavedHeight = 0;
 	float SavedDistance = 0;
 	FRotator SavedRotation = FRotator::ZeroRotator;
 	bool bIsInit = false;
 
+	//InitPath计算的轨迹参数, 水平方向的偏移由两条折线解析求出
+	FVector AvgMidPoint = FVector::ZeroVector;
+	float Dist1toMid = 0;
+	float DistMidto2 = 0;
+	float Dist1toAvgMid = 0;
+	float DistAvgMidto2 = 0;
+
+	/** 从起点经过MidPoint到终点的折线上, 走过MoveFraction比例的点到起点的水平距离 */
+	float GetPolylineDistance2D(const FVector& MidPoint, float DistToMid, float DistFromMid, float MoveFraction) const;
+
 public:
 	FVector GetPathOffset(float MoveFraction) const;
 
 	FVector GetRelativeLocation(float MoveFraction) const;
 
+	/** 按Times(与GetTime相同, 超出[0, Duration]时取端点)批量求值角色中心的位置, OutLocations与Times一一对应 */
+	bool SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+	                      TArrayView<FVector> OutLocations) const;
+
 	virtual bool IsTimeOutEnabled() const override;
 
 	virtual FRootMotionSource* Clone() const override;
@@ -120,6 +224,8 @@ public:
 	virtual bool Matches(const FRootMotionSource* Other) const override;
 
 	virtual bool MatchesAndHasSameState(const FRootMotionSource* Other) const override;
+	/** 可变状态的指纹, MatchesAndHasSameState里比较 */
+	uint64 GetStateFingerprint() const;
 
 	virtual bool UpdateStateFrom(const FRootMotionSource* SourceToTakeStateFrom, bool bMarkForSimulatedCatchup = false) override;
 
@@ -138,7 +244,8 @@ public:
 
 	virtual void AddReferencedObjects(class FReferenceCollector& Collector) override;
 
-	void InitPath(const ACharacter& Character);
+	/** 应用时调用, 求解轨迹参数, 不分配任何对象 */
+	void InitPath();
 };
 
 
@@ -157,6 +264,7 @@ USTRUCT()
 struct RMS_API FRootMotionSource_MoveToForce_WithRotation : public FRootMotionSource_MoveToForce
 {
 	GENERATED_USTRUCT_BODY()
+	RMS_DECLARE_SOURCE_ALLOCATOR()
 	FRootMotionSource_MoveToForce_WithRotation();
 
 	virtual ~FRootMotionSource_MoveToForce_WithRotation()
@@ -186,6 +294,36 @@ struct RMS_API FRootMotionSource_MoveToForce_WithRotation : public FRootMotionSo
 	FRMSRotationSetting RotationSetting;
 	UPROPERTY()
 	FRotator StartRotation = FRotator::ZeroRotator;
+	//生成的路径偏移, 有效时优先于PathOffsetCurve
+	UPROPERTY()
+	FRMSPathCurve PathOffset;
+
+	//应用时创建, 复制到模拟端的RMS没有查找表, 直接求值曲线
+	FRMSCurveLUTSet CurveLUTs;
+
+	//RMSNetQuantize::FFingerprint::AddPathOffset, Matches里代替逐点比较, 为0时还没有计算
+	uint64 PathOffsetFingerprint = 0;
+
+	void BuildCurveLUTs()
+	{
+		CurveLUTs.Build(nullptr, PathOffsetCurve, RotationSetting.Curve);
+		UpdatePathOffsetFingerprint();
+	}
+
+	/** 修改PathOffsetCurve/PathOffset之后调用 */
+	void UpdatePathOffsetFingerprint();
+
+	/** 隐藏父类的同名函数, 优先使用查找表 */
+	FVector GetPathOffsetInWorldSpace(const float MoveFraction) const;
+
+	FORCEINLINE FVector GetLocationAtFraction(float MoveFraction) const
+	{
+		return FMath::Lerp<FVector, float>(StartLocation, TargetLocation, MoveFraction) + GetPathOffsetInWorldSpace(MoveFraction);
+	}
+
+	/** 按Times(与GetTime相同, 超出[0, Duration]时取端点)批量求值角色中心的位置, OutLocations与Times一一对应 */
+	bool SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+	                      TArrayView<FVector> OutLocations) const;
 protected:
 	// UPROPERTY()
 	// FRotator TargetRotation = FRotator::ZeroRotator;
@@ -206,6 +344,7 @@ USTRUCT()
 struct RMS_API FRootMotionSource_MoveToDynamicForce_WithRotation : public FRootMotionSource_MoveToDynamicForce
 {
 	GENERATED_USTRUCT_BODY()
+	RMS_DECLARE_SOURCE_ALLOCATOR()
 	FRootMotionSource_MoveToDynamicForce_WithRotation()
 	{
 	};
@@ -227,10 +366,98 @@ struct RMS_API FRootMotionSource_MoveToDynamicForce_WithRotation : public FRootM
 	virtual bool Matches(const FRootMotionSource* Other) const override;
 
 	virtual bool MatchesAndHasSameState(const FRootMotionSource* Other) const override;
+	/** 可变状态的指纹, MatchesAndHasSameState里比较 */
+	uint64 GetStateFingerprint() const;
+
+	virtual bool UpdateStateFrom(const FRootMotionSource* SourceToTakeStateFrom, bool bMarkForSimulatedCatchup = false) override;
 	UPROPERTY()
 	FRMSRotationSetting RotationSetting;
 	UPROPERTY()
 	FRotator StartRotation = FRotator::ZeroRotator;
+	//生成的路径偏移, 有效时优先于PathOffsetCurve
+	UPROPERTY()
+	FRMSPathCurve PathOffset;
+
+	/**
+	 * 从当前位置和时间重新开始一段移动
+	 * 只有服务器(bAuthority)增加序号, 之后同步时只发送序号, 起始旋转, 新的目标和量化后的起点, 客户端得到与服务器相同的这一段
+	 * 客户端本地的预测不改变序号, 只认服务器发来的序号
+	 */
+	void Retarget(const FVector& NewStartLocation, const FRotator& NewStartRotation, const FVector& NewTargetLocation,
+	              float NewDuration, bool bAuthority);
+
+	uint8 GetRetargetSequence() const
+	{
+		return RetargetSequence;
+	}
+
+	/** 按UpdatePolicy请求新的目标, 返回false表示请求被忽略 */
+	bool RequestTargetLocation(const ACharacter& Character, const FVector& NewTargetLocation);
+	/** 按UpdatePolicy请求新的总时长(以当前这一段的时间计), 返回false表示请求被忽略 */
+	bool RequestDuration(const ACharacter& Character, float NewDuration);
+	/** 应用缓存的请求, 间隔不够时继续保留, 返回是否重新设定了目标 */
+	bool ApplyPendingUpdate(const ACharacter& Character);
+
+	FORCEINLINE bool HasPendingUpdate() const
+	{
+		return bHasPendingTarget || bHasPendingDuration;
+	}
+
+	FRMSDynamicUpdatePolicy UpdatePolicy;
+	//已应用和被忽略(死区, 合并, 无效)的请求数
+	uint32 AppliedUpdates = 0;
+	uint32 SuppressedUpdates = 0;
+
+	//应用时创建, 复制到模拟端的RMS没有查找表, 直接求值曲线
+	FRMSCurveLUTSet CurveLUTs;
+
+	//RMSNetQuantize::FFingerprint::AddPathOffset, Matches里代替逐点比较, 为0时还没有计算
+	uint64 PathOffsetFingerprint = 0;
+
+	void BuildCurveLUTs()
+	{
+		CurveLUTs.Build(TimeMappingCurve, PathOffsetCurve, RotationSetting.Curve);
+		UpdatePathOffsetFingerprint();
+	}
+
+	/** 修改PathOffsetCurve/PathOffset之后调用 */
+	void UpdatePathOffsetFingerprint();
+
+	/** 隐藏父类的同名函数, 优先使用查找表 */
+	FVector GetPathOffsetInWorldSpace(const float MoveFraction) const;
+
+	/** MoveFraction(已经过TimeMapping)时应该到达的位置 */
+	virtual FVector GetTargetLocationAtFraction(float MoveFraction) const
+	{
+		return FMath::Lerp<FVector, float>(StartLocation, TargetLocation, MoveFraction) + GetPathOffsetInWorldSpace(MoveFraction);
+	}
+
+	/** 按Times(与GetTime相同, 超出[0, Duration]时取端点)批量求值角色中心的位置, OutLocations与Times一一对应 */
+	bool SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+	                      TArrayView<FVector> OutLocations) const;
+
+protected:
+	/** 不经过父类的移动, 没有旋转设置时只处理位移 */
+	void PrepareMoveTo(float SimulationTime, float MovementTickTime, const ACharacter& Character,
+	                   const UCharacterMovementComponent& MoveComponent);
+
+	//服务器每次Retarget加1, 为0时说明还是应用时的那一段
+	uint8 RetargetSequence = 0;
+	//本地已经Retarget过(包括客户端的预测), 用来计算MinInterval, 不同步
+	bool bRetargeted = false;
+
+	//缓存的请求只属于正在运行的这一个, 复制到SavedMove里会在重放时再应用一次
+	FORCEINLINE void ClearPendingUpdate()
+	{
+		bHasPendingTarget = false;
+		bHasPendingDuration = false;
+	}
+
+	//还未应用的请求, 不参与同步, Clone时不复制
+	FVector PendingTargetLocation = FVector::ZeroVector;
+	float PendingDuration = 0.f;
+	bool bHasPendingTarget = false;
+	bool bHasPendingDuration = false;
 };
 
 template <>
@@ -243,10 +470,70 @@ struct TStructOpsTypeTraits<FRootMotionSource_MoveToDynamicForce_WithRotation> :
 	};
 };
 
+
+/**
+ * 抛物线移动, 每帧直接求值ParabolaCurve, 不需要生成路径曲线
+ * 水平方向线性移动, Z = Start.Z + (Target.Z - Start.Z) * ParabolaCurve(MoveFraction), 曲线按时间范围映射到[0, 1]
+ * 没有曲线时用解析抛物线: 在直线上叠加 4 * ParabolaHeight * f * (1 - f), 最高点在中间; ParabolaHeight为0时直线移动
+ */
+USTRUCT()
+struct RMS_API FRootMotionSource_MoveToForce_Parabola : public FRootMotionSource_MoveToDynamicForce_WithRotation
+{
+	GENERATED_USTRUCT_BODY()
+	RMS_DECLARE_SOURCE_ALLOCATOR()
+	FRootMotionSource_MoveToForce_Parabola()
+	{
+	};
+
+	virtual ~FRootMotionSource_MoveToForce_Parabola()
+	{
+	}
+
+	UPROPERTY()
+	TObjectPtr<UCurveFloat> ParabolaCurve = nullptr;
+
+	//没有ParabolaCurve时, 最高点相对起点和终点连线的高度
+	UPROPERTY()
+	float ParabolaHeight = 0.f;
+
+	/** 与URMSLibrary::PredictRootMotionSourceLocation_MoveToParabola共用 */
+	static FVector GetParabolaLocation(const FVector& Start, const FVector& Target, const UCurveFloat* Curve,
+	                                   float Height, float MoveFraction);
+
+	virtual FVector GetTargetLocationAtFraction(float MoveFraction) const override
+	{
+		return GetParabolaLocation(StartLocation, TargetLocation, ParabolaCurve, ParabolaHeight, MoveFraction);
+	}
+
+	virtual void PrepareRootMotion(
+		float SimulationTime,
+		float MovementTickTime,
+		const ACharacter& Character,
+		const UCharacterMovementComponent& MoveComponent
+	) override;
+	virtual UScriptStruct* GetScriptStruct() const override;
+	virtual FString ToSimpleString() const override;
+	virtual bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess) override;
+	virtual FRootMotionSource* Clone() const override;
+	virtual bool Matches(const FRootMotionSource* Other) const override;
+	virtual void AddReferencedObjects(class FReferenceCollector& Collector) override;
+};
+
+template <>
+struct TStructOpsTypeTraits<FRootMotionSource_MoveToForce_Parabola> : public TStructOpsTypeTraitsBase2<FRootMotionSource_MoveToForce_Parabola>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithCopy = true
+	};
+};
+
 USTRUCT()
 struct RMS_API FRootMotionSource_AnimWarping : public FRootMotionSource
 {
 	GENERATED_USTRUCT_BODY()
+	RMS_DECLARE_SOURCE_ALLOCATOR()
 	FRootMotionSource_AnimWarping()
 	{
 	};
@@ -281,6 +568,26 @@ protected:
 	UPROPERTY()
 	float CachedEndTime = -1;
 
+	//共享的烘焙RootMotion, 第一次提取时获取
+	mutable FRMSBakedRootMotionPtr BakedRootMotion;
+
+	//起始空间, 初始化时计算一次
+	FTransform StartFootTransform = FTransform::Identity;
+	FTransform Mesh2CharInverse = FTransform::Identity;
+
+	void InitStartSpace(const FRMSCharacterFrameContext& Context)
+	{
+		StartFootTransform = FTransform(StartRotation, StartLocation - FVector(0.f, 0.f, Context.HalfHeight));
+		Mesh2CharInverse = StartFootTransform.GetRelativeTransform(Context.MeshTransform);
+	}
+
+	//动画在[InStartTime, InEndTime]的RootMotion转换到起始空间后的世界Transform
+	FTransform GetRootMotionTargetInStartSpace(const FRMSCharacterFrameContext& Context, float InStartTime,
+	                                           float InEndTime) const
+	{
+		return Mesh2CharInverse * (ExtractRootMotion(InStartTime, InEndTime) * Context.MeshTransform);
+	}
+
 	FORCEINLINE float GetCurrentAnimEndTime() const
 	{
 		return CachedEndTime <= 0 ? AnimEndTime : CachedEndTime;
@@ -312,6 +619,23 @@ public:
 	};
 
 	virtual FTransform ProcessRootMotion(const ACharacter& Character, const FTransform& InRootMotion, float InPreviousTime, float InCurrentTime, float DeltaSeconds);
+
+	/**
+	 * 按Times(与GetTime相同, 超出[0, Duration]时取端点)批量预测角色中心的位置
+	 * 与ProcessRootMotion使用同一个FRMSWarpKernel, 但是一次扭曲整段RootMotion, 不考虑碰撞和旋转扭曲带来的偏转
+	 */
+	virtual bool SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+	                              TArrayView<FVector> OutLocations) const;
+
+protected:
+	/** 动画在[StartAnimTime, EndAnimTime]的RootMotion按起始空间(StartRotation)转换到世界空间的位移 */
+	FVector GetWorldRootMotionOffset(USkeletalMeshComponent& Mesh, float StartAnimTime, float EndAnimTime) const;
+
+	/** 从SegmentStart出发, 把SegmentRootOffset这一整段RootMotion扭曲到SegmentTarget时, AnimTime的脚底位置 */
+	FVector PredictWarpedFootLocation(USkeletalMeshComponent& Mesh, const FVector& SegmentStart,
+	                                  const FVector& SegmentTarget, const FVector& SegmentRootOffset,
+	                                  float SegmentStartAnimTime, float AnimTime) const;
+public:
 	FQuat WarpRotation(const ACharacter& Character, const FTransform& RootMotionDelta, const FTransform& RootMotionTotal, float TimeRemaining, float DeltaSeconds);
 
 
@@ -332,6 +656,8 @@ public:
 	virtual bool Matches(const FRootMotionSource* Other) const override;
 
 	virtual bool MatchesAndHasSameState(const FRootMotionSource* Other) const override;
+	/** 可变状态的指纹, MatchesAndHasSameState里比较 */
+	virtual uint64 GetStateFingerprint() const;
 	virtual UScriptStruct* GetScriptStruct() const override;
 	virtual FString ToSimpleString() const override;
 	virtual void AddReferencedObjects(class FReferenceCollector& Collector) override;
@@ -353,6 +679,7 @@ USTRUCT()
 struct RMS_API FRootMotionSource_AnimWarping_FinalPoint : public FRootMotionSource_AnimWarping
 {
 	GENERATED_USTRUCT_BODY()
+	RMS_DECLARE_SOURCE_ALLOCATOR()
 	FRootMotionSource_AnimWarping_FinalPoint()
 	{
 	};
@@ -380,6 +707,8 @@ public:
 	virtual FRootMotionSource* Clone() const override;
 
 	virtual bool Matches(const FRootMotionSource* Other) const override;
+	virtual bool SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+	                              TArrayView<FVector> OutLocations) const override;
 
 	virtual UScriptStruct* GetScriptStruct() const override;
 	virtual FString ToSimpleString() const override;
@@ -399,6 +728,7 @@ USTRUCT()
 struct RMS_API FRootMotionSource_AnimWarping_MultiTargets : public FRootMotionSource_AnimWarping
 {
 	GENERATED_USTRUCT_BODY()
+	RMS_DECLARE_SOURCE_ALLOCATOR()
 	FRootMotionSource_AnimWarping_MultiTargets()
 	{
 	};
@@ -408,15 +738,32 @@ struct RMS_API FRootMotionSource_AnimWarping_MultiTargets : public FRootMotionSo
 	}
 
 
-	UPROPERTY()
-	TArray<FRMSTarget> TriggerDatas;
+	/** 设置所有窗口的目标, 之后不能再修改, 所有复制体共享同一份 */
+	void SetTriggerDatas(TArray<FRMSTarget> InTriggerDatas);
+
+	const TArray<FRMSTarget>& GetTriggerDatas() const;
+
 protected:
-	UPROPERTY()
-	FRMSTarget CurrTriggerData;
-	UPROPERTY()
-	FRMSTarget LastTriggerData;
+	//应用后只读, Clone时只增加引用计数
+	TSharedPtr<const TArray<FRMSTarget>, ESPMode::ThreadSafe> TriggerDatas;
+	//RMSNetQuantize::HashTargets(TriggerDatas), 与TriggerDatas一起设置
+	uint64 TriggerDatasFingerprint = 0;
+
+	//当前所在的TriggerDatas下标, 只会向前移动, -1表示还没有初始化
+	int32 TriggerIndex = INDEX_NONE;
 
+	FORCEINLINE const FRMSTarget& GetCurrTriggerData() const
+	{
+		return (*TriggerDatas)[TriggerIndex];
+	}
 
+	//上一段的目标, 第一段时返回nullptr
+	FORCEINLINE const FRMSTarget* GetLastTriggerData() const
+	{
+		return TriggerIndex > 0 ? &(*TriggerDatas)[TriggerIndex - 1] : nullptr;
+	}
+
+	/** 一帧可能跨过多个窗口, 一直前进到包含当前时间的那一段, 下标改变时返回true */
 	bool UpdateTriggerTarget(float SimulationTime, float TimeScale);
 public:
 	virtual void PrepareRootMotion(
@@ -431,9 +778,13 @@ public:
 	virtual FRootMotionSource* Clone() const override;
 
 	virtual bool Matches(const FRootMotionSource* Other) const override;
+	virtual uint64 GetStateFingerprint() const override;
+	virtual bool SampleTrajectory(const ACharacter& Character, TConstArrayView<float> Times,
+	                              TArrayView<FVector> OutLocations) const override;
 
 	virtual UScriptStruct* GetScriptStruct() const override;
 	virtual FString ToSimpleString() const override;
+	virtual void AddReferencedObjects(class FReferenceCollector& Collector) override;
 };
 
 template <>
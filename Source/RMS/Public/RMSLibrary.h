@@ -13,6 +13,7 @@
 
 class URMSComponent;
 class UCurveVector;
+struct FRootMotionSource_MoveToDynamicForce_WithRotation;
 enum class ERootMotionAccumulateMode : uint8;
 class UCharacterMovementComponent;
 
@@ -111,8 +112,10 @@ public:
 	* ParabolaCurve X轴定义时间曲线, Z轴定义抛物线形态曲线
 	* @param StartLocation      角色会基于此开始移动,所以请确保是Actor当前的Location
 	* @param TargetLocation		参考StartLocation的目标位置(要考虑HalfHeight)
-	* @param ParabolaCurve      定义抛物线形态
+	* @param ParabolaCurve      定义抛物线形态, 每帧直接求值, 为空时使用ParabolaHeight
+	* @param ParabolaHeight     没有ParabolaCurve时解析抛物线最高点相对直线的高度, 为0时直线移动
 	* @param RotationSetting	旋转设置, 具体看每个参数自己的注释
+	* @param Segment			已废弃, 不再把抛物线采样成路径曲线
 	* @param ApplyMode	        RMS的应用模式, 默认是队列, 即存在同名RMS的情况下会在后台执行直到前一个运行完
 	* 
 	*/
@@ -132,7 +135,8 @@ public:
 	                                                        float StartTime = 0,
 	                                                        ERMSApplyMode ApplyMode =
 		                                                        ERMSApplyMode::None,
-	                                                        FRMSSetting_Move ExtraSetting = {});
+	                                                        FRMSSetting_Move ExtraSetting = {},
+	                                                        float ParabolaHeight = 0);
 
 
 	/**
@@ -312,12 +316,30 @@ public:
 	static bool GetRootMotionSourceWindowsByInstanceList(UAnimSequence* DataAnimation, TArray<FName> Instances,
 	                                                     TArray<FRMSWindowData>& Windows);
 
+	/*
+	 * 二分查找包含Time的窗口, TriggerData必须按StartTime排序且互不重叠(每个StartTime不早于上一个的EndTime)
+	 * 动画Warping生成的TriggerData满足这个条件
+	*/
 	static bool FindTriggerDataByTime(const TArray<FRMSNotifyTriggerData>& TriggerData, float Time,
 	                                  FRMSNotifyTriggerData& OutData);
 
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category="RMS", meta = (AdvancedDisplay = "7"))
 	static FTransform ExtractRootMotion(UAnimSequenceBase* Anim, float StartTime, float EndTime);
 
+	/**
+	 * 一次遍历得到逐帧的累计RootMotion, OutTrack[i] 等价于 ExtractRootMotion(0, StartTime + i * FrameTime)
+	 * 时间步进方式与 for (float t = StartTime; t <= EndTime; t += FrameTime) 完全一致, 可以直接用循环次数作为下标
+	 */
+	static void ExtractRootMotionTrack(UAnimSequenceBase* Anim, float StartTime, float EndTime, float FrameTime,
+	                                   TArray<FTransform>& OutTrack);
+
+	/**
+	 * 编辑器下给动画添加或者重新生成URMSAnimationAssetUserData, 可以在编辑器工具蓝图里对选中的资源调用
+	 * SampleRate <= 0 时保留资源上已有的采样率, 返回处理成功的数量, 非编辑器下什么也不做
+	 */
+	UFUNCTION(BlueprintCallable, Category="RMS|Editor", meta = (DevelopmentOnly))
+	static int32 BakeAnimationRootMotionData(const TArray<UAnimSequenceBase*>& Animations, float SampleRate = 60);
+
 #pragma endregion Animation
 
 	//模拟力的RootMotion效果,类似AddForce
@@ -356,6 +378,23 @@ public:
 	UFUNCTION(BlueprintCallable, Category="RMS", meta = (AdvancedDisplay = "7"))
 	static void UpdateDynamicMoveDuration(UCharacterMovementComponent* MovementComponent, FName InstanceName,
 	                                      float NewDuration);
+	/*
+	 * 设置DynamicMoveTo的刷新策略: 最小间隔, 距离死区, 是否合并到下一次移动Tick
+	 * 只影响调用UpdateDynamicMoveToTarget/UpdateDynamicMoveDuration的一端
+	*/
+	UFUNCTION(BlueprintCallable, Category="RMS", meta = (AdvancedDisplay = "7"))
+	static void SetDynamicMoveUpdatePolicy(UCharacterMovementComponent* MovementComponent, FName InstanceName,
+	                                       const FRMSDynamicUpdatePolicy& Policy);
+	/*
+	 * 注册AnimWarping同步时使用的动画, 注册后只发送下标而不是对象引用
+	 * 服务器和所有客户端必须以相同的顺序注册相同的动画, 顺序不一致时同步失败而不是解析成别的动画
+	*/
+	UFUNCTION(BlueprintCallable, Category="RMS|Animation")
+	static void RegisterNetAnimations(const TArray<UAnimSequenceBase*>& Animations);
+	//DynamicMoveTo已应用和被忽略的刷新次数
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category="RMS", meta = (AdvancedDisplay = "7"))
+	static void GetDynamicMoveUpdateStats(UCharacterMovementComponent* MovementComponent, FName InstanceName,
+	                                      int32& AppliedUpdates, int32& SuppressedUpdates);
 
 	//移除RMS
 	UFUNCTION(BlueprintCallable, Category="RMS", meta = (AdvancedDisplay = "7"))
@@ -377,6 +416,9 @@ public:
 	                                                         FName InstanceName);
 	static TSharedPtr<FRootMotionSource_MoveToDynamicForce> GetDynamicMoveToRootMotionSource(
 		UCharacterMovementComponent* MovementComponent, FName InstanceName);
+	/** 类型不是FRootMotionSource_MoveToDynamicForce_WithRotation(或子类)时返回空 */
+	static TSharedPtr<FRootMotionSource_MoveToDynamicForce_WithRotation> GetDynamicMoveToWithRotationRootMotionSource(
+		UCharacterMovementComponent* MovementComponent, FName InstanceName);
 
 	static TSharedPtr<FRootMotionSource> GetRootMotionSourceByID(UCharacterMovementComponent* MovementComponent,
 	                                                             int32 ID);
@@ -397,6 +439,47 @@ public:
 
 	static float EvaluateFloatCurveAtFraction(const UCurveFloat& Curve, const float Fraction);
 	static FVector EvaluateVectorCurveAtFraction(const UCurveVector& Curve, const float Fraction);
+
+	/**
+	* 与ApplyRootMotionSource_MoveToForce相同, 路径偏移使用生成的FRMSPathCurve, 不需要创建UCurveVector
+	* PathOffset在Start到Target的朝向空间里, PathOffsetCurve只在PathOffset无效时使用
+	*/
+	static int32 ApplyRootMotionSource_MoveToForce_Path(UCharacterMovementComponent* MovementComponent,
+	                                                    FName InstanceName,
+	                                                    FVector StartLocation,
+	                                                    FVector TargetLocation,
+	                                                    float Duration,
+	                                                    int32 Priority,
+	                                                    const FRMSPathCurve& PathOffset,
+	                                                    FRMSRotationSetting RotationSetting = {},
+	                                                    float StartTime = 0,
+	                                                    ERMSApplyMode ApplyMode = ERMSApplyMode::None,
+	                                                    FRMSSetting_Move ExtraSetting = {},
+	                                                    UCurveVector* PathOffsetCurve = nullptr);
+	/** 与PredictRootMotionSourceLocation_MoveTo相同, 路径偏移使用FRMSPathCurve */
+	static bool PredictRootMotionSourceLocation_MoveToPath(FVector& OutLocation, FVector StartLocation,
+	                                                       FVector TargetLocation, float Duration, float CurrentTime,
+	                                                       const FRMSPathCurve& PathOffset);
+	/**
+	 * 一次采样RMS在多个时间点的位置(角色中心), 时间与RMS的GetTime相同, 超出[0, Duration]时取端点
+	 * 按GetScriptStruct分发到各个RMS自己的求值, 支持本插件的所有RMS以及引擎的MoveTo/DynamicMoveTo/Jump
+	 * OutLocations由调用者分配, 长度必须与Times相同; 不支持的类型返回false
+	 */
+	static bool SampleRootMotionSourceTrajectory(const FRootMotionSource& RootMotionSource, const ACharacter& Character,
+	                                             TConstArrayView<float> Times, TArrayView<FVector> OutLocations);
+	/*
+	 * 一次采样正在运行的RMS在多个时间点的位置, 代替在循环里调用PredictRootMotionSourceLocation_Runtime
+	 */
+	UFUNCTION(BlueprintCallable, Category="RMS", BlueprintPure)
+	static bool SampleRootMotionSourceTrajectory_Times(UCharacterMovementComponent* MovementComponent, FName InstanceName,
+	                                                   const TArray<float>& Times, TArray<FVector>& OutLocations);
+	/*
+	 * 从StartTime开始每隔DeltaTime采样一次, 共NumSamples个
+	 */
+	UFUNCTION(BlueprintCallable, Category="RMS", BlueprintPure)
+	static bool SampleRootMotionSourceTrajectory_FixedStep(UCharacterMovementComponent* MovementComponent,
+	                                                       FName InstanceName, float StartTime, float DeltaTime,
+	                                                       int32 NumSamples, TArray<FVector>& OutLocations);
 	/*
 	 * 根据时间预测正在运行的RMS的实时位置
 	 */
@@ -437,5 +520,6 @@ public:
 	                                                           FVector StartLocation, FVector TargetLocation,
 	                                                           float Duration,
 	                                                           float CurrentTime, UCurveFloat* ParabolaCurve = nullptr,
-	                                                           UCurveFloat* TimeMappingCurve = nullptr);
+	                                                           UCurveFloat* TimeMappingCurve = nullptr,
+	                                                           float ParabolaHeight = 0);
 };
@@ -0,0 +1,152 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RMSTypes.h"
+#include "Misc/FrameRate.h"
+
+class UAnimSequenceBase;
+
+/**
+ * RMS NetSerialize使用的量化格式
+ * 位置: SerializePackedVector<10, 24>, 精度0.1, 目标点相对StartLocation或者上一个目标点, 数值越小占用越少
+ * 旋转: Yaw固定16位, Pitch/Roll为0时只占1位, 否则16位
+ * 时间: 毫秒定点数, ZigZag后按变长整数写入
+ * 路径偏移: 0.1精度的定点数, 每个采样点相对上一个采样点, ZigZag后按变长整数写入
+ * 曲线: 资源曲线作为对象引用发送, 运行时创建的曲线客户端找不到, 位移曲线采样后发送, 其他曲线发送空
+ * 动画: 注册过的动画只发送表里的下标和16位路径校验, 否则发送对象引用; 动画里的时间与帧对齐时发送帧序号
+ * 每个RMS在父类数据之后先写一个版本号, 版本不同时反序列化失败, 修改格式时增加Version
+ */
+namespace RMSNetQuantize
+{
+static constexpr uint8 Version = 8;
+
+static constexpr float LocationTolerance = 0.1f;
+static constexpr float RotationTolerance = 360.f / 65536.f;
+static constexpr float TimeTolerance = 0.001f;
+
+/** 版本不匹配时返回false */
+RMS_API bool SerializeVersion(FArchive& Ar);
+
+RMS_API bool SerializeLocation(FArchive& Ar, FVector& Location);
+/** 写入Location - Origin, 读取时加回Origin */
+RMS_API bool SerializeOffset(FArchive& Ar, FVector& Location, const FVector& Origin);
+RMS_API void SerializeRotator(FArchive& Ar, FRotator& Rotator);
+RMS_API void SerializeTime(FArchive& Ar, float& Time);
+/** 可以为负数的小整数, 比如为-1的下标 */
+RMS_API void SerializeInt(FArchive& Ar, int32& Value);
+
+/**
+ * 注册需要同步的动画, 之后只发送下标, 已经注册过的会跳过
+ * 服务器和所有客户端必须以相同的顺序注册相同的动画, 比如启动时从同一个资源读取列表
+ * 每个下标附带动画路径的校验, 两端的表不一致时反序列化失败, 不会解析成别的动画
+ */
+RMS_API void RegisterAnimations(const TArray<UAnimSequenceBase*>& Animations);
+/** 没有注册时返回INDEX_NONE */
+RMS_API int32 FindAnimationIndex(const UAnimSequenceBase* Animation);
+RMS_API void SerializeAnimation(FArchive& Ar, TObjectPtr<UAnimSequenceBase>& Animation);
+/** 动画的采样帧率, 没有动画时无效 */
+RMS_API FFrameRate GetAnimationFrameRate(const UAnimSequenceBase* Animation);
+/** 与帧对齐时发送帧序号, 否则与SerializeTime相同; Rate无效时总是按时间发送 */
+RMS_API void SerializeFrameTime(FArchive& Ar, float& Time, const FFrameRate& Rate);
+
+/** 客户端能否通过对象引用找到这条曲线 */
+RMS_API bool IsNetAddressable(const UObject* Curve);
+RMS_API void WarnNotAddressable(const UObject* Curve);
+
+/** 只发送客户端能找到的曲线, 否则发送空 */
+template <typename TCurvePtr>
+void SerializeAssetCurve(FArchive& Ar, TCurvePtr& Curve)
+{
+	if (Ar.IsSaving() && Curve && !IsNetAddressable(Curve))
+	{
+		WarnNotAddressable(Curve);
+		TCurvePtr NullCurve = nullptr;
+		Ar << NullCurve;
+		return;
+	}
+	Ar << Curve;
+}
+
+RMS_API void SerializeRotationSetting(FArchive& Ar, FRMSRotationSetting& Setting);
+RMS_API void SerializePathCurve(FArchive& Ar, FRMSPathCurve& PathCurve);
+/**
+ * 路径偏移, PathOffset有效时优先发送; 否则资源曲线发送引用, 运行时创建的曲线按 b.RMS.NetCurveSamples 采样后发送
+ * 客户端收到采样数据时Curve为空, 数据在PathOffset里
+ */
+RMS_API void SerializePathOffset(FArchive& Ar, TObjectPtr<UCurveVector>& Curve, FRMSPathCurve& PathOffset);
+/** 每一段的目标相对上一段的目标, 第一段相对Origin */
+RMS_API bool SerializePath(FArchive& Ar, TArray<FRMSPathMoveToData>& Path, const FVector& Origin);
+/** 目标相对上一个目标, 第一个相对Origin; 时间按Rate的帧序号发送 */
+RMS_API bool SerializeTargets(FArchive& Ar, TArray<FRMSTarget>& Targets, const FVector& Origin,
+                              const FFrameRate& Rate);
+
+/** 与SerializeLocation相同的量化, 在0.1的网格上 */
+FORCEINLINE FVector QuantizeLocation(const FVector& Location)
+{
+	return FVector(FMath::RoundToDouble(Location.X * 10.0), FMath::RoundToDouble(Location.Y * 10.0),
+	               FMath::RoundToDouble(Location.Z * 10.0)) / 10.0;
+}
+
+/** 量化误差以内视为相同, Matches里使用, 避免本地的原始数据与服务器发来的量化数据对不上 */
+FORCEINLINE bool LocationEquals(const FVector& A, const FVector& B)
+{
+	return A.Equals(B, LocationTolerance);
+}
+
+FORCEINLINE bool RotatorEquals(const FRotator& A, const FRotator& B)
+{
+	return A.Equals(B, RotationTolerance);
+}
+
+FORCEINLINE bool TimeEquals(float A, float B)
+{
+	return FMath::IsNearlyEqual(A, B, TimeTolerance);
+}
+
+/** 客户端收不到不能同步的曲线, 两边都不能同步时视为相同 */
+FORCEINLINE bool AssetCurveEquals(const UObject* A, const UObject* B)
+{
+	return A == B || (!IsNetAddressable(A) && !IsNetAddressable(B));
+}
+
+RMS_API bool RotationSettingEquals(const FRMSRotationSetting& A, const FRMSRotationSetting& B);
+RMS_API bool PathCurveEquals(const FRMSPathCurve& A, const FRMSPathCurve& B);
+/** 一边是曲线一边是采样数据时(本地应用的和服务器发来的), 在采样点上比较 */
+RMS_API bool PathOffsetEquals(const UCurveVector* CurveA, const FRMSPathCurve& PathA, const UCurveVector* CurveB,
+                              const FRMSPathCurve& PathB);
+RMS_API bool PathEquals(const TArray<FRMSPathMoveToData>& A, const TArray<FRMSPathMoveToData>& B);
+RMS_API bool TargetsEquals(const TArray<FRMSTarget>& A, const TArray<FRMSTarget>& B);
+
+/**
+ * 按量化后的值计算的64位指纹, 本地应用的原始数据与服务器发来的量化数据得到相同的结果
+ * 只在同一个进程里比较, 曲线按对象地址参与计算, 客户端找不到的曲线视为空
+ * 正好落在量化边界上时两边可能不同, 指纹不同时需要再按误差比较一次
+ */
+class RMS_API FFingerprint
+{
+public:
+	FORCEINLINE void AddInt(int64 Value)
+	{
+		Words.Add(Value);
+	}
+
+	void AddLocation(const FVector& Location);
+	void AddRotator(const FRotator& Rotator);
+	void AddTime(float Time);
+	void AddObject(const UObject* Object);
+	void AddRotationSetting(const FRMSRotationSetting& Setting);
+	/** 与SerializePathOffset相同的规则, 运行时创建的曲线按采样后的数据计算 */
+	void AddPathOffset(const UCurveVector* Curve, const FRMSPathCurve& PathOffset);
+
+	uint64 Get() const;
+
+private:
+	TArray<int64, TInlineAllocator<32>> Words;
+};
+
+RMS_API uint64 HashPath(const TArray<FRMSPathMoveToData>& Path);
+RMS_API uint64 HashTargets(const TArray<FRMSTarget>& Targets);
+}
@@ -0,0 +1,160 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RMSAnimationCache.h"
+
+class UAnimSequenceBase;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * RootMotion库的二进制格式, 所有结构体按自然对齐, 可以直接从映射的内存中读取
+ *
+ * Header | ClipEntry[NumClips] | Sample[] | WindowEntry[] | 字符串表(UTF8)
+ *
+ * 位移是相对动画起点的定点数(int16 * TranslationScale), 朝向只保留Yaw(uint16)
+ * 整个库使用同一个采样率, 每个动画均分为NumSamples - 1段
+ */
+namespace RMSRootMotionLibrary
+{
+static constexpr uint32 Magic = 0x4C534D52; // "RMSL"
+static constexpr uint32 Version = 1;
+
+struct FHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 SampleRate;
+	uint32 NumClips;
+	uint32 StringTableOffset;
+	uint32 StringTableSize;
+};
+
+struct FClipEntry
+{
+	uint32 NameOffset;
+	uint32 NameLength;
+	float PlayLength;
+	float TranslationScale;
+	uint32 NumSamples;
+	uint32 SampleOffset;
+	uint32 NumWindows;
+	uint32 WindowOffset;
+};
+
+struct FSample
+{
+	int16 X;
+	int16 Y;
+	int16 Z;
+	uint16 Yaw;
+};
+
+struct FWindowEntry
+{
+	uint32 NameOffset;
+	uint32 NameLength;
+	float StartTime;
+	float EndTime;
+};
+
+static_assert(sizeof(FHeader) == 24 && sizeof(FClipEntry) == 32 && sizeof(FSample) == 8 && sizeof(FWindowEntry) == 16,
+              "RMSRootMotionLibrary layout changed, bump Version");
+}
+
+struct FRMSRootMotionLibraryWindow
+{
+	FName RootMotionSourceTarget;
+	float StartTime = 0.f;
+	float EndTime = 0.f;
+};
+
+/**
+ * 只读的RootMotion库, 文件通过内存映射加载, 不需要加载动画数据
+ */
+class RMS_API FRMSRootMotionLibrary
+{
+public:
+	~FRMSRootMotionLibrary();
+
+	static TSharedPtr<FRMSRootMotionLibrary, ESPMode::ThreadSafe> LoadFromFile(const FString& Filename);
+	static TSharedPtr<FRMSRootMotionLibrary, ESPMode::ThreadSafe> LoadFromMemory(TArray<uint8>&& Data);
+
+	int32 GetNumClips() const
+	{
+		return Header ? Header->NumClips : 0;
+	}
+
+	float GetSampleRate() const
+	{
+		return Header ? Header->SampleRate : 0.f;
+	}
+
+	/** 动画的PathName, 没有返回INDEX_NONE */
+	int32 FindClip(FName ClipName) const;
+	int32 FindClip(const UAnimSequenceBase* Animation) const;
+
+	FName GetClipName(int32 ClipIndex) const;
+	float GetPlayLength(int32 ClipIndex) const;
+
+	//与URMSLibrary::ExtractRootMotion相同的语义
+	FTransform ExtractRootMotion(int32 ClipIndex, float StartTime, float EndTime) const;
+	void GetWindows(int32 ClipIndex, TArray<FRMSRootMotionLibraryWindow>& OutWindows) const;
+
+	/** 解码成烘焙缓存使用的格式 */
+	FRMSBakedRootMotionPtr MakeBakedRootMotion(int32 ClipIndex) const;
+
+	SIZE_T GetClipDataSize(int32 ClipIndex) const;
+
+private:
+	FRMSRootMotionLibrary() = default;
+	bool Initialize(const uint8* InData, int64 InSize);
+	FTransform GetRootMotionAtTime(const RMSRootMotionLibrary::FClipEntry& Clip, float Time) const;
+	FName ReadName(uint32 Offset, uint32 Length) const;
+
+	const uint8* Data = nullptr;
+	int64 DataSize = 0;
+	const RMSRootMotionLibrary::FHeader* Header = nullptr;
+	const RMSRootMotionLibrary::FClipEntry* Clips = nullptr;
+	TMap<FName, int32> ClipIndexByName;
+
+	TArray<uint8> OwnedData;
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+};
+
+typedef TSharedPtr<FRMSRootMotionLibrary, ESPMode::ThreadSafe> FRMSRootMotionLibraryPtr;
+
+/**
+ * 从动画生成RootMotion库, 数据来自URMSLibrary::ExtractRootMotion和GetRootMotionSourceWindows
+ */
+class RMS_API FRMSRootMotionLibraryBuilder
+{
+public:
+	explicit FRMSRootMotionLibraryBuilder(int32 InSampleRate = 30)
+		: SampleRate(FMath::Max(1, InSampleRate))
+	{
+	}
+
+	/** 添加动画并打印与原动画的内存对比 */
+	bool AddClip(UAnimSequenceBase* Animation);
+
+	void Write(TArray<uint8>& OutData) const;
+	bool SaveToFile(const FString& Filename) const;
+
+private:
+	struct FClip
+	{
+		FString Name;
+		float PlayLength = 0.f;
+		float TranslationScale = 1.f;
+		TArray<RMSRootMotionLibrary::FSample> Samples;
+		TArray<FRMSRootMotionLibraryWindow> Windows;
+	};
+
+	int32 SampleRate;
+	TArray<FClip> Clips;
+};
@@ -0,0 +1,117 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/ScopeLock.h"
+
+/**
+ * RMS结构体的分块分配器, 每个类型一个, 释放的内存回到自己的空闲链表
+ * Clone()和Apply时的new/MakeShareable都走这里, CharacterMovementComponent用默认删除器释放时也会回到这里
+ * 引擎反序列化同步过来的RMS时用FMemory::Malloc加InitializeStruct创建, 不经过类的operator new, 但仍然通过它释放
+ * 所以按地址所在的页判断内存是不是来自分块, 不是的话交还给FMemory, 不计入分块的统计
+ * 注意不能用MakeShared, 它会把对象和引用计数分配在一起, 绕开类的operator new
+ */
+namespace RMSSourceAllocator
+{
+RMS_API void TrackAllocate(bool bFromSlab);
+RMS_API void TrackFree(bool bFromSlab);
+}
+
+template <typename T>
+class TRMSSourceSlab
+{
+public:
+	static void* Allocate(size_t Size)
+	{
+		//派生类没有声明自己的分配器时, 大小不同, 回退到普通堆分配
+		const bool bFromSlab = Size == sizeof(T);
+		RMSSourceAllocator::TrackAllocate(bFromSlab);
+		return bFromSlab ? Get().AllocateBlock() : FMemory::Malloc(Size);
+	}
+
+	static void Free(void* Ptr, size_t Size)
+	{
+		if (!Ptr)
+		{
+			return;
+		}
+		//大小相同也可能是引擎用FMemory创建的
+		const bool bFromSlab = Size == sizeof(T) && Get().FreeBlock(Ptr);
+		RMSSourceAllocator::TrackFree(bFromSlab);
+		if (!bFromSlab)
+		{
+			FMemory::Free(Ptr);
+		}
+	}
+
+private:
+	static_assert(alignof(T) <= 16, "RMS slab blocks are 16 byte aligned");
+
+	static constexpr SIZE_T BlockSize = Align(sizeof(T), 16);
+	//页按自身大小对齐, 地址向下对齐就是所在页的起点, 不需要读取块里的内容
+	static constexpr SIZE_T PageSize = 64 * 1024;
+	static_assert(BlockSize <= PageSize, "RMS source is larger than a slab page");
+
+	struct FSlab
+	{
+		FCriticalSection Lock;
+		void* FreeList = nullptr;
+		TSet<UPTRINT> Pages;
+
+		void* AllocateBlock()
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (!FreeList)
+			{
+				uint8* Page = static_cast<uint8*>(FMemory::Malloc(PageSize, PageSize));
+				Pages.Add(reinterpret_cast<UPTRINT>(Page));
+				for (SIZE_T Offset = PageSize / BlockSize * BlockSize; Offset >= BlockSize; Offset -= BlockSize)
+				{
+					void* Block = Page + Offset - BlockSize;
+					*static_cast<void**>(Block) = FreeList;
+					FreeList = Block;
+				}
+			}
+			void* Block = FreeList;
+			FreeList = *static_cast<void**>(Block);
+			return Block;
+		}
+
+		/** 不是来自分块时返回false */
+		bool FreeBlock(void* Ptr)
+		{
+			const UPTRINT Page = reinterpret_cast<UPTRINT>(Ptr) & ~static_cast<UPTRINT>(PageSize - 1);
+			FScopeLock ScopeLock(&Lock);
+			if (!Pages.Contains(Page))
+			{
+				return false;
+			}
+			*static_cast<void**>(Ptr) = FreeList;
+			FreeList = Ptr;
+			return true;
+		}
+	};
+
+	static FSlab& Get()
+	{
+		static FSlab Slab;
+		return Slab;
+	}
+};
+
+/**
+ * 在RMS结构体里声明类的operator new/delete, 定义放在cpp里, 保证所有模块使用同一个分块
+ * 放置new也要声明, 否则类里的operator new会隐藏全局的放置new
+ */
+#define RMS_DECLARE_SOURCE_ALLOCATOR() \
+	static void* operator new(size_t Size); \
+	static void operator delete(void* Ptr, size_t Size); \
+	static void* operator new(size_t Size, void* Place) { return Place; } \
+	static void operator delete(void* Ptr, void* Place) {}
+
+#define RMS_IMPLEMENT_SOURCE_ALLOCATOR(Type) \
+	void* Type::operator new(size_t Size) { return TRMSSourceSlab<Type>::Allocate(Size); } \
+	void Type::operator delete(void* Ptr, size_t Size) { TRMSSourceSlab<Type>::Free(Ptr, Size); }
@@ -5,11 +5,30 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "Curves/RichCurve.h"
 #include "RMSTypes.generated.h"
 
+//调试绘制和日志的编译开关, 由RMS.Build.cs定义, Shipping下为0
+#ifndef RMS_DEBUG
+#define RMS_DEBUG !UE_BUILD_SHIPPING
+#endif
+
+DECLARE_STATS_GROUP(TEXT("RMS"), STATGROUP_RMS, STATCAT_Advanced);
+
 namespace RMS
 {
+#if RMS_DEBUG
 RMS_API extern TAutoConsoleVariable<int32> CVarRMS_Debug;
+RMS_API extern TAutoConsoleVariable<int32> CVarRMS_ValidateWarpKernel;
+#endif
+RMS_API extern TAutoConsoleVariable<float> CVarRMS_RootMotionBakeRate;
+RMS_API extern TAutoConsoleVariable<int32> CVarRMS_CurveLUTResolution;
+RMS_API extern TAutoConsoleVariable<float> CVarRMS_CurveLUTTolerance;
+RMS_API extern TAutoConsoleVariable<int32> CVarRMS_CurvePoolMaxSize;
+RMS_API extern TAutoConsoleVariable<float> CVarRMS_CurvePoolRecycleDelay;
+RMS_API extern TAutoConsoleVariable<int32> CVarRMS_NetCurveSamples;
+RMS_API extern TAutoConsoleVariable<int32> CVarRMS_PathCurveMaxSamples;
+RMS_API extern TAutoConsoleVariable<float> CVarRMS_PathCurveTolerance;
 }
 
 
@@ -133,6 +152,63 @@ public:
 };
 
 
+/**
+ * 按固定间隔采样的路径偏移, 在[0,1]上等间距, 首尾都包含, 取代运行时生成的UCurveVector
+ * 按值存在RMS里, 不需要GC, 求值是一次下标计算和一次插值
+ */
+USTRUCT()
+struct RMS_API FRMSPathCurve
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	TArray<FVector3f> Samples;
+
+	FORCEINLINE bool IsValid() const
+	{
+		return Samples.Num() > 1;
+	}
+
+	/** 与URMSLibrary::EvaluateVectorCurveAtFraction相同的语义, 超出0-1时保持端点的值 */
+	FORCEINLINE FVector Evaluate(float Fraction) const
+	{
+		const float Pos = FMath::Clamp(Fraction, 0.f, 1.f) * (Samples.Num() - 1);
+		const int32 Index = FMath::Min(FMath::FloorToInt(Pos), Samples.Num() - 2);
+		const VectorRegister4Float A = VectorLoadFloat3(&Samples[Index].X);
+		const VectorRegister4Float B = VectorLoadFloat3(&Samples[Index + 1].X);
+		const VectorRegister4Float Result = VectorMultiplyAdd(VectorSubtract(B, A), VectorSetFloat1(Pos - Index), A);
+		FVector3f Out;
+		VectorStoreFloat3(Result, &Out.X);
+		return FVector(Out);
+	}
+
+	void Reset()
+	{
+		Samples.Reset();
+	}
+
+	/** 把三个轴的曲线(X, Y, Z)在它们共同的时间范围内等间距采样, 没有关键帧时路径无效 */
+	static FRMSPathCurve Sample(const FRichCurve& CurveX, const FRichCurve& CurveY, const FRichCurve& CurveZ,
+	                            int32 NumSamples);
+	static FRMSPathCurve Sample(const class UCurveVector& Curve, int32 NumSamples);
+
+	/**
+	 * 等间距重新采样到最少的点数, 使得在原来每个采样点上的误差不超过Tolerance, 最多MaxSamples个
+	 * 逐帧生成的路径有几百个点, 每次同步都要整体发送, 应用时先精简, 服务器模拟和发送的是同一份数据
+	 */
+	FRMSPathCurve Simplify(int32 MaxSamples, float Tolerance) const;
+
+	friend FArchive& operator <<(FArchive& Ar, FRMSPathCurve& D)
+	{
+		return Ar << D.Samples;
+	}
+
+	bool operator==(const FRMSPathCurve& Other) const
+	{
+		return Samples == Other.Samples;
+	}
+};
+
 USTRUCT(BlueprintType)
 struct FRMSPathMoveToData
 {
@@ -150,15 +226,20 @@ public:
 	UPROPERTY(BlueprintReadWrite)
 	FRMSRotationSetting RotationSetting;
 
+	//生成的路径偏移, 有效时优先于PathOffsetCurve
+	UPROPERTY()
+	FRMSPathCurve PathOffset;
+
 	friend FArchive& operator <<(FArchive& Ar, FRMSPathMoveToData& D)
 	{
-		return Ar << D.Duration << D.Target << D.PathOffsetCurve << D.TimeMappingCurve << D.RotationSetting;
+		return Ar << D.Duration << D.Target << D.PathOffsetCurve << D.TimeMappingCurve << D.RotationSetting << D.PathOffset;
 	}
 
 	bool operator==(const FRMSPathMoveToData& Other) const
 	{
 		return Target == Other.Target && Duration == Other.Duration && PathOffsetCurve == Other.PathOffsetCurve &&
-			TimeMappingCurve == Other.TimeMappingCurve && RotationSetting == Other.RotationSetting;
+			TimeMappingCurve == Other.TimeMappingCurve && RotationSetting == Other.RotationSetting && PathOffset ==
+			Other.PathOffset;
 	}
 
 	bool operator!=(const FRMSPathMoveToData& Other) const
@@ -210,6 +291,26 @@ public:
 	bool bFinishOnLanded = false;
 };
 
+/**
+ * 动态目标的刷新策略, 只在调用UpdateDynamicMoveToTarget/UpdateDynamicMoveDuration的一端生效
+ */
+USTRUCT(BlueprintType)
+struct FRMSDynamicUpdatePolicy
+{
+	GENERATED_BODY()
+public:
+	//两次重新设定目标的最小间隔(秒), 期间的请求只保留最后一个
+	UPROPERTY(BlueprintReadWrite)
+	float MinInterval = 0.f;
+	//新目标与当前目标(或者还未应用的目标)的距离小于此值时忽略
+	UPROPERTY(BlueprintReadWrite)
+	float DeadBand = 0.1f;
+	//默认立即应用; 为true时请求先缓存, 在下一次移动Tick开始时只应用最后一个
+	//缓存期间TargetLocation和轨迹预测仍然是旧的目标, RMS在此之前结束时请求被丢弃
+	UPROPERTY(BlueprintReadWrite)
+	bool bCoalescePerFrame = false;
+};
+
 USTRUCT(BlueprintType)
 struct FRMSAnimWarppingConfig
 {
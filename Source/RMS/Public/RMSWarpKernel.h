@@ -0,0 +1,62 @@
+//  Copyright. VJ  All Rights Reserved.
+//  https://supervj.top/2022/03/24/RootMotionSource/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * AnimWarping的位移扭曲
+ * 原实现在RootMotion同步空间里构造 缩放 * 沿Y偏斜 * 沿Z偏斜 三个矩阵, 展开后只剩一个与坐标系无关的闭式:
+ * C = 剩余动画RootMotion, W = 到目标的偏移, T = 这一帧的RootMotion
+ * Result = T + (T·C / |C|²) * (W - C)
+ * T·C为0(沿C方向没有位移)时, 原实现退化为 W * |T| / |C|
+ */
+struct RMS_API FRMSWarpKernel
+{
+	/** |C|接近0时返回T */
+	static FORCEINLINE FVector WarpTranslation(const FVector& Translation, const FVector& CurrentToRoot,
+	                                           const FVector& CurrentToWorld)
+	{
+		const VectorRegister T = VectorLoadFloat3_W0(&Translation.X);
+		const VectorRegister C = VectorLoadFloat3_W0(&CurrentToRoot.X);
+		const VectorRegister W = VectorLoadFloat3_W0(&CurrentToWorld.X);
+		FVector Out;
+		VectorStoreFloat3(WarpTranslation(T, C, W), &Out.X);
+		return Out;
+	}
+
+	static FORCEINLINE VectorRegister WarpTranslation(const VectorRegister& T, const VectorRegister& C,
+	                                                  const VectorRegister& W)
+	{
+		const VectorRegister CC = VectorDot3(C, C);
+		if (VectorGetComponent(CC, 0) <= UE_SMALL_NUMBER)
+		{
+			return T;
+		}
+		const VectorRegister WC = VectorDot3(W, C);
+		if (VectorGetComponent(WC, 0) != 0.0)
+		{
+			const VectorRegister Scale = VectorDivide(VectorDot3(T, C), CC);
+			return VectorMultiplyAdd(Scale, VectorSubtract(W, C), T);
+		}
+		//与原实现相同, 目标与动画方向垂直时, 沿目标方向按长度比例移动
+		const VectorRegister TT = VectorDot3(T, T);
+		const VectorRegister WW = VectorDot3(W, W);
+		if (VectorGetComponent(TT, 0) == 0.0 || VectorGetComponent(WW, 0) == 0.0)
+		{
+			return VectorZeroDouble();
+		}
+		return VectorMultiply(W, VectorSqrt(VectorDivide(TT, CC)));
+	}
+
+	/** 批量计算, 每个下标是一个角色, 所有数组长度必须相同 */
+	static void WarpTranslations(TConstArrayView<FVector> Translations, TConstArrayView<FVector> CurrentToRoot,
+	                             TConstArrayView<FVector> CurrentToWorld, TArrayView<FVector> OutTranslations);
+
+#if RMS_DEBUG
+	/** 原来的矩阵实现, 只用于校验和性能对比 */
+	static FVector WarpTranslation_Reference(const FVector& Translation, const FVector& CurrentToRoot,
+	                                         const FVector& CurrentToWorld, const FQuat& CurrentRotation);
+#endif
+};
@@ -7,6 +7,9 @@ public class RMS : ModuleRules
 	public RMS(ReadOnlyTargetRules Target) : base(Target)
 	{
 		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		// Debug draw and verbose logging are compiled out of Shipping builds
+		PublicDefinitions.Add("RMS_DEBUG=" + (Target.Configuration == UnrealTargetConfiguration.Shipping ? "0" : "1"));
 		
 		PublicIncludePaths.AddRange(
 			new string[] {